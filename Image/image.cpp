@@ -18,24 +18,29 @@ Pixel32::Pixel32( void ) : r(0) , g(0) , b(0) , a(255) {}
 /////////////
 // Image32 //
 /////////////
-Image32::Image32( void ) : _width(0) , _height(0) , _pixels(NULL) {}
+Image32::Layout Image32::DefaultLayout = Image32::ROW_MAJOR;
 
-Image32::Image32( const Image32& img ) : _width(0) , _height(0) , _pixels(NULL)
+Image32::Image32( void ) : _width(0) , _height(0) , _layout(DefaultLayout) , _pixels(NULL) {}
+
+Image32::Image32( const Image32& img ) : _width(0) , _height(0) , _layout(img._layout) , _pixels(NULL)
 {
 	setSize( img._width , img._height );
-	memcpy( _pixels , img._pixels , sizeof(Pixel32)*_width*_height );
+	memcpy( _pixels , img._pixels , sizeof(Pixel32)*_StorageSize( _width , _height , _layout ) );
 }
 
 Image32& Image32::operator = ( const Image32& img )
 {
+	// The number of pixel values stored depends on the layout, so the pixels are reallocated if the layout changes
+	if( _layout!=img._layout ) setSize( 0 , 0 ) , _layout = img._layout;
 	setSize( img._width , img._height );
-	memcpy( _pixels , img._pixels , sizeof(Pixel32)*_width*_height );
+	memcpy( _pixels , img._pixels , sizeof(Pixel32)*_StorageSize( _width , _height , _layout ) );
 	return *this;
 }
 
 Image32::Image32( Image32&& img )
 {
 	_width = img._width , _height = img._height;
+	_layout = img._layout;
 	_pixels = img._pixels;
 	img._width = img._height = 0;
 	img._pixels = NULL;
@@ -45,6 +50,7 @@ Image32& Image32::operator = ( Image32&& img )
 {
 	swap( _width , img._width );
 	swap( _height , img._height );
+	swap( _layout , img._layout );
 	swap( _pixels , img._pixels );
 	return *this;
 }
@@ -59,12 +65,40 @@ void Image32::setSize( int width , int height )
 		_pixels = NULL;
 		_width = _height = 0;
 		if( !width*height ) return;
-		_pixels = new Pixel32[width*height];
+		_pixels = new Pixel32[ _StorageSize( width , height , _layout ) ];
 		if( !_pixels ) THROW( "Failed to allocate memory for image: " , width , " x " , height );
 	}
 	_width = width;
 	_height = height;
-	memset( _pixels , 0 , sizeof(Pixel32)*_width*_height );
+	memset( _pixels , 0 , sizeof(Pixel32)*_StorageSize( _width , _height , _layout ) );
+}
+
+Image32::Layout Image32::layout( void ) const { return _layout; }
+
+void Image32::setLayout( Layout layout )
+{
+	if( layout==_layout ) return;
+	Image32 img;
+	img._layout = layout;
+	img.setSize( _width , _height );
+	for( int y=0 ; y<_height ; y++ ) for( int x=0 ; x<_width ; x++ ) img._pixels[ img._index(x,y) ] = _pixels[ _index(x,y) ];
+	*this = std::move( img );
+}
+
+size_t Image32::_StorageSize( int width , int height , Layout layout )
+{
+	if( layout==TILED ) return (size_t)( ( width+TileSize-1 ) / TileSize ) * ( ( height+TileSize-1 ) / TileSize ) * TileSize * TileSize;
+	else return (size_t)width * height;
+}
+
+inline size_t Image32::_index( int x , int y ) const
+{
+	if( _layout==TILED )
+	{
+		unsigned int _x = (unsigned int)x , _y = (unsigned int)y , tilesX = ( (unsigned int)_width+TileSize-1 ) / TileSize;
+		return ( (size_t)( _y/TileSize ) * tilesX + _x/TileSize ) * ( TileSize*TileSize ) + ( _y%TileSize ) * TileSize + _x%TileSize;
+	}
+	else return (size_t)x + (size_t)y*_width;
 }
 
 void Image32::_assertInBounds( int x , int y ) const
@@ -75,13 +109,13 @@ void Image32::_assertInBounds( int x , int y ) const
 Pixel32& Image32::operator() ( int x , int y )
 {
 	_assertInBounds( x , y );
-	return _pixels[x+y*_width];
+	return _pixels[ _index(x,y) ];
 }
 
 const Pixel32& Image32::operator() ( int x , int y ) const
 {
 	_assertInBounds( x , y );
-	return _pixels[x+y*_width];
+	return _pixels[ _index(x,y) ];
 }
 
 int Image32::width( void ) const { return _width; }
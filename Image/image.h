@@ -33,14 +33,41 @@ namespace Image
 	/** This class represents an RGBA image with 8 bits per channel. */
 	class Image32
 	{
+	public:
+		/** The layouts in which the pixels can be stored.
+		*** With the ROW_MAJOR layout the pixels are stored one row after the other.
+		*** With the TILED layout the image is split into square tiles that are stored one after the other (in row-major order), with the pixels within a tile stored in row-major order,
+		*** so that pixels that are close in the image are close in memory (as for the 2D-local accesses of filtering and rotating). */
+		enum Layout
+		{
+			ROW_MAJOR ,
+			TILED
+		};
+
+		/** The width (and height) of the tiles in the TILED layout */
+		static const int TileSize = 8;
+
+		/** The layout used by newly constructed images */
+		static Layout DefaultLayout;
+
+	private:
 		/** The dimensions of the image */
 		int _width , _height;
 
+		/** The layout of the pixels */
+		Layout _layout;
+
 		/** The pixel values */
 		Pixel32* _pixels;
 
 		/** The method validates that the pixel index is valid */
 		void _assertInBounds( int x , int y ) const;
+
+		/** This method returns the offset of the pixel within the pixel values */
+		size_t _index( int x , int y ) const;
+
+		/** This static method returns the number of pixel values stored for an image with the prescribed dimensions and layout (including the padding of partial tiles) */
+		static size_t _StorageSize( int width , int height , Layout layout );
 	public:
 
 		/** A struct for iterating through the pixels. */
@@ -64,19 +91,20 @@ namespace Image
 			friend Image32;
 			Pixel32 *_p;
 		};
+		/** The iterators visit the pixel values in the order in which they are stored, which for the TILED layout includes the padding of partial tiles. */
 		iterator begin( void ){ return iterator( _pixels ); }
-		iterator   end( void ){ return iterator( _pixels+_width*_height ); }
+		iterator   end( void ){ return iterator( _pixels+_StorageSize( _width , _height , _layout ) ); }
 
 		/** The default constructor */
 		Image32( void );
 
-		/** The copy constructor copies pixel values */
+		/** The copy constructor copies pixel values (and the layout) */
 		Image32( const Image32& img );
 
 		/** The move constructor moves pixel ownership from the input to the new object. */
 		Image32( Image32&& img );
 
-		/** The copy assignment operator copies pixel values */
+		/** The copy assignment operator copies pixel values (and the layout) */
 		Image32& operator = ( const Image32& img );
 
 		/** The move assignment operator moves pixel ownership from the input to the new object. */
@@ -94,6 +122,12 @@ namespace Image
 		/** This method returns the height of the image */
 		int height( void ) const;
 
+		/** This method returns the layout of the pixels */
+		Layout layout( void ) const;
+
+		/** This method changes the layout of the pixels, preserving their values. */
+		void setLayout( Layout layout );
+
 		/** This method returns a reference to the indexed pixel.
 		*** An exception is thrown if the index is out of bounds. */
 		Pixel32& operator() ( int x , int y );
@@ -45,7 +45,7 @@ void Box::initOpenGL( void )
 
 bool Box::processFirstIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
-	RayTracingStats::IncrementRayPrimitiveIntersectionNum();
+	RayTracingStats::IncrementRayPrimitiveIntersectionNum( tIdx );
 	spInfo.material = _material;
 
 	/////////////////////////////////////////////////////////////
@@ -57,7 +57,7 @@ bool Box::processFirstIntersection( const Util::Ray3D &ray , const Util::Boundin
 
 int Box::processAllIntersections( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
-	RayTracingStats::IncrementRayPrimitiveIntersectionNum();
+	RayTracingStats::IncrementRayPrimitiveIntersectionNum( tIdx );
 	spInfo.material = _material;
 
 	/////////////////////////////////////////////////////////////
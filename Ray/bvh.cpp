@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <type_traits>
+#include <Util/exceptions.h>
+#include "bvh.h"
+
+using namespace Ray;
+using namespace Util;
+
+/////////
+// BVH //
+/////////
+void BVH::clear( void )
+{
+	_nodes.clear();
+	_indices.clear();
+}
+
+void BVH::set( const std::vector< BoundingBox3D > &bBoxes , unsigned int leafSize )
+{
+	clear();
+	if( !bBoxes.size() ) return;
+	if( !leafSize ) leafSize = 1;
+
+	std::vector< Point3D > centers( bBoxes.size() );
+	_indices.resize( bBoxes.size() );
+	for( unsigned int i=0 ; i<bBoxes.size() ; i++ )
+	{
+		_indices[i] = i;
+		centers[i] = ( bBoxes[i][0] + bBoxes[i][1] ) / 2;
+	}
+	_nodes.reserve( 2*bBoxes.size() );
+	_set( bBoxes , centers , 0 , (unsigned int)bBoxes.size() , leafSize , 0 );
+}
+
+BoundingBox3D BVH::boundingBox( void ) const
+{
+	BoundingBox3D bBox;
+	if( _nodes.size() ) for( int d=0 ; d<3 ; d++ ) bBox[0][d] = _nodes[0].bBox[0][d] , bBox[1][d] = _nodes[0].bBox[1][d];
+	return bBox;
+}
+
+unsigned int BVH::_set( const std::vector< BoundingBox3D > &bBoxes , const std::vector< Point3D > &centers , unsigned int begin , unsigned int end , unsigned int leafSize , unsigned int depth )
+{
+	// The number of bins used to approximate the surface area heuristic
+	static const unsigned int BinNum = 16;
+	// The (relative) cost of traversing a node
+	static const double TraversalCost = 1.;
+
+	// The bounding boxes are accumulated explicitly (rather than through BoundingBox3D::operator +) so that flat boxes are not discarded as empty
+	struct Bounds
+	{
+		double p[2][3];
+		Bounds( void ){ for( int d=0 ; d<3 ; d++ ) p[0][d] = Infinity , p[1][d] = -Infinity; }
+		void add( const Point3D &q ){ for( int d=0 ; d<3 ; d++ ) p[0][d] = std::min< double >( p[0][d] , q[d] ) , p[1][d] = std::max< double >( p[1][d] , q[d] ); }
+		void add( const BoundingBox3D &b ){ add( b[0] ) , add( b[1] ); }
+		void add( const Bounds &b ){ for( int d=0 ; d<3 ; d++ ) p[0][d] = std::min< double >( p[0][d] , b.p[0][d] ) , p[1][d] = std::max< double >( p[1][d] , b.p[1][d] ); }
+		double area( void ) const
+		{
+			double e[3];
+			for( int d=0 ; d<3 ; d++ ) e[d] = std::max< double >( p[1][d] - p[0][d] , 0 );
+			return e[0]*e[1] + e[1]*e[2] + e[2]*e[0];
+		}
+	};
+
+	unsigned int nodeIndex = (unsigned int)_nodes.size();
+	_nodes.push_back( Node() );
+
+	Bounds bounds , centerBounds;
+	for( unsigned int i=begin ; i<end ; i++ ) bounds.add( bBoxes[ _indices[i] ] ) , centerBounds.add( centers[ _indices[i] ] );
+	for( int d=0 ; d<3 ; d++ ) _nodes[nodeIndex].bBox[0][d] = bounds.p[0][d] , _nodes[nodeIndex].bBox[1][d] = bounds.p[1][d];
+
+	unsigned int count = end - begin;
+	auto MakeLeaf = [&]( void )
+	{
+		_nodes[nodeIndex].offset = begin;
+		_nodes[nodeIndex].count = count;
+		_nodes[nodeIndex].axis = 0;
+		return nodeIndex;
+	};
+	if( count==1 ) return MakeLeaf();
+
+	// Find the best split using binned centers
+	unsigned int splitAxis = 0 , splitBin = 0;
+	double splitCost = Infinity;
+	for( unsigned int d=0 ; d<3 ; d++ )
+	{
+		double extent = centerBounds.p[1][d] - centerBounds.p[0][d];
+		if( extent<=0 ) continue;
+
+		Bounds binBounds[ BinNum ];
+		unsigned int binCounts[ BinNum ] = {};
+		for( unsigned int i=begin ; i<end ; i++ )
+		{
+			unsigned int b = std::min< unsigned int >( (unsigned int)( ( centers[ _indices[i] ][d] - centerBounds.p[0][d] ) / extent * BinNum ) , BinNum-1 );
+			binCounts[b]++;
+			binBounds[b].add( bBoxes[ _indices[i] ] );
+		}
+
+		// Sweep from the right to get the areas/counts of the suffixes
+		double rightAreas[ BinNum ];
+		unsigned int rightCounts[ BinNum ];
+		{
+			Bounds right;
+			unsigned int rightCount = 0;
+			for( unsigned int b=BinNum-1 ; b>0 ; b-- )
+			{
+				right.add( binBounds[b] ) , rightCount += binCounts[b];
+				rightAreas[b] = right.area() , rightCounts[b] = rightCount;
+			}
+		}
+
+		// Sweep from the left, evaluating the cost of splitting before bin b
+		Bounds left;
+		unsigned int leftCount = 0;
+		for( unsigned int b=1 ; b<BinNum ; b++ )
+		{
+			left.add( binBounds[b-1] ) , leftCount += binCounts[b-1];
+			if( !leftCount || !rightCounts[b] ) continue;
+			double cost = left.area() * leftCount + rightAreas[b] * rightCounts[b];
+			if( cost<splitCost ) splitCost = cost , splitAxis = d , splitBin = b;
+		}
+	}
+
+	double area = bounds.area();
+	if( area>0 ) splitCost = TraversalCost + splitCost / area;
+	else if( splitCost<Infinity ) splitCost = TraversalCost + count;
+
+	// Make a leaf if it is cheaper than splitting (or if the tree has reached its maximum depth)
+	if( depth>=MaxDepth || ( count<=leafSize && splitCost>=count ) ) return MakeLeaf();
+
+	unsigned int mid;
+	if( splitCost<Infinity && depth<MaxDepth/2 )
+	{
+		double extent = centerBounds.p[1][splitAxis] - centerBounds.p[0][splitAxis];
+		double minCenter = centerBounds.p[0][splitAxis];
+		unsigned int *split = std::partition( &_indices[0]+begin , &_indices[0]+end , [&]( unsigned int idx )
+		{
+			return std::min< unsigned int >( (unsigned int)( ( centers[idx][splitAxis] - minCenter ) / extent * BinNum ) , BinNum-1 ) < splitBin;
+		} );
+		mid = (unsigned int)( split - &_indices[0] );
+	}
+	else mid = begin;
+
+	// If the binned split failed (e.g. all centers coincide) or the tree is too deep, split at the median
+	if( mid==begin || mid==end )
+	{
+		unsigned int axis = 0;
+		for( unsigned int d=1 ; d<3 ; d++ ) if( centerBounds.p[1][d]-centerBounds.p[0][d] > centerBounds.p[1][axis]-centerBounds.p[0][axis] ) axis = d;
+		mid = begin + count/2;
+		std::nth_element( &_indices[0]+begin , &_indices[0]+mid , &_indices[0]+end , [&]( unsigned int i1 , unsigned int i2 ){ return centers[i1][axis]<centers[i2][axis]; } );
+		splitAxis = axis;
+	}
+
+	_set( bBoxes , centers , begin , mid , leafSize , depth+1 );
+	unsigned int secondChild = _set( bBoxes , centers , mid , end , leafSize , depth+1 );
+	_nodes[nodeIndex].offset = secondChild;
+	_nodes[nodeIndex].count = 0;
+	_nodes[nodeIndex].axis = splitAxis;
+	return nodeIndex;
+}
+
+/////////////////
+// TriangleBVH //
+/////////////////
+void TriangleBVH::clear( void )
+{
+	BVH::clear();
+	for( int i=0 ; i<9 ; i++ ) _soa[i].clear();
+	for( int i=0 ; i<3 ; i++ ) _compactVertices[i].clear();
+}
+
+void TriangleBVH::_set( unsigned int leafSize )
+{
+	bool compact = !_compactVertices[0].empty();
+	size_t triangleNum = compact ? _compactVertices[0].size() : _soa[0].size();
+	std::vector< BoundingBox3D > bBoxes( triangleNum );
+	for( size_t i=0 ; i<triangleNum ; i++ )
+	{
+		// The boxes are fit to the stored (possibly rounded) positions, so that they contain the triangles that are intersected
+		if( compact )
+		{
+			Point3F p[] = { _compactVertices[0][i] , _compactVertices[1][i] , _compactVertices[2][i] };
+			bBoxes[i] = BoundingBox3D( BoundingBox3F( p , 3 ) );
+		}
+		else
+		{
+			Point3D p[3];
+			for( int d=0 ; d<3 ; d++ ) p[0][d] = _soa[d][i] , p[1][d] = _soa[d][i] + _soa[3+d][i] , p[2][d] = _soa[d][i] + _soa[6+d][i];
+			bBoxes[i] = BoundingBox3D( p , 3 );
+		}
+	}
+	BVH::set( bBoxes , leafSize );
+
+	// Reorder the arrays so that the triangles in a leaf are contiguous
+	auto Reorder = [&]( auto &arrays )
+	{
+		typename std::remove_reference< decltype( arrays[0] ) >::type temp( triangleNum );
+		for( auto &a : arrays )
+		{
+			for( size_t i=0 ; i<triangleNum ; i++ ) temp[i] = a[ _indices[i] ];
+			std::swap( a , temp );
+		}
+	};
+	if( compact ) Reorder( _compactVertices );
+	else Reorder( _soa );
+}
@@ -0,0 +1,169 @@
+#ifndef BVH_INCLUDED
+#define BVH_INCLUDED
+#include <vector>
+#include <Util/geometry.h>
+#include <Util/alignedAllocator.h>
+#include "shape.h"
+
+namespace Ray
+{
+	/** This class represents a bounding volume hierarchy over a set of primitives, described by their bounding boxes.
+	*** The hierarchy is built using the (binned) surface area heuristic and is stored as a flattened array of cache-line sized nodes,
+	*** with the first child of an interior node stored immediately after the node. */
+	class BVH
+	{
+	public:
+		/** This class represents a node in the hierarchy */
+		struct Node
+		{
+			/** The bounding box of the node, stored as the minimum and maximum corners */
+			double bBox[2][3];
+
+			/** For an interior node this is the index of the second child. For a leaf node it is the index of the first primitive. */
+			unsigned int offset;
+
+			/** The number of primitives in a leaf node (or zero for an interior node) */
+			unsigned int count;
+
+			/** The axis along which an interior node was split */
+			unsigned int axis;
+
+			/** Padding so that a node fills a cache line */
+			unsigned int _padding;
+		};
+		static_assert( sizeof(Node)==Util::CacheLineSize , "[ERROR] BVH nodes should be the size of a cache line" );
+
+		/** The default number of primitives below which a node may become a leaf */
+		static const unsigned int DefaultLeafSize = 4;
+
+		/** The maximum depth of the hierarchy (beyond which nodes are split at the median) */
+		static const unsigned int MaxDepth = 64;
+
+		/** This method builds the hierarchy over the primitives with the prescribed bounding boxes. */
+		void set( const std::vector< Util::BoundingBox3D > &bBoxes , unsigned int leafSize=DefaultLeafSize );
+
+		/** This method clears the hierarchy. */
+		void clear( void );
+
+		/** This method returns true if the hierarchy has not been built. */
+		bool empty( void ) const;
+
+		/** This method returns the number of nodes in the hierarchy. */
+		size_t size( void ) const;
+
+		/** This method returns the list of nodes. */
+		const Util::AlignedVector< Node > &nodes( void ) const;
+
+		/** This method returns the index of the primitive stored at the prescribed (leaf) position. */
+		unsigned int index( unsigned int i ) const;
+
+		/** This method returns the bounding box of the hierarchy. */
+		Util::BoundingBox3D boundingBox( void ) const;
+
+		/** This method traverses the hierarchy front-to-back, calling the leaf function on every leaf whose bounding box intersects the ray within the range.
+		*** The leaf function is called as leafFunction( begin , end ), where [begin,end) is the range of leaf positions, and returns true if the traversal should terminate.
+		*** The leaf function may shrink the range (e.g. after finding a closer intersection), in which case nodes beyond the range are skipped.
+		*** The method returns true if the traversal was terminated by the leaf function. */
+		template< typename LeafFunction >
+		bool traverse( const Util::Ray3D &ray , Util::BoundingBox1D &range , LeafFunction leafFunction , unsigned int tIdx ) const;
+
+		/** This method traverses the hierarchy with a packet of rays, calling the leaf function on every leaf whose bounding box intersects one of the active rays within its range.
+		*** The leaf function is called as leafFunction( begin , end , mask ), where [begin,end) is the range of leaf positions and mask marks the rays intersecting the leaf's bounding box.
+		*** The leaf function may shrink the ranges of the rays. Once the packet has diverged, the remaining rays are traversed individually. */
+		template< typename LeafFunction >
+		void traverse( RayPacket &packet , LeafFunction leafFunction , unsigned int tIdx ) const;
+
+	protected:
+		/** The packet is considered to have diverged when no more than one in this many rays remain active */
+		static const unsigned int PacketDivergenceRatio = 4;
+
+		/** The flattened list of nodes */
+		Util::AlignedVector< Node > _nodes;
+
+		/** The indices of the primitives, ordered so that the primitives in a leaf are contiguous */
+		std::vector< unsigned int > _indices;
+
+		/** This method recursively builds the sub-tree over the primitives with indices in the range [begin,end) and returns the index of the sub-tree's root. */
+		unsigned int _set( const std::vector< Util::BoundingBox3D > &bBoxes , const std::vector< Util::Point3D > &centers , unsigned int begin , unsigned int end , unsigned int leafSize , unsigned int depth );
+
+		/** This method traverses the sub-tree rooted at the prescribed node, which is assumed to have already been intersected by the ray, entering at time t. */
+		template< typename LeafFunction >
+		bool _traverse( unsigned int root , double t , const Util::ReciprocalRay3D &ray , Util::BoundingBox1D &range , LeafFunction leafFunction , unsigned int tIdx ) const;
+
+		/** This method computes the (entry) time at which the ray enters the node, returning false if it does not intersect the node within the range [tMin,tMax]. */
+		static bool _Intersect( const Node &node , const Util::ReciprocalRay3D &ray , double tMin , double tMax , double &t , unsigned int tIdx );
+
+		/** This method returns the subset of the masked rays of the packet (given in structure-of-arrays form) that intersect the node within their ranges, and sets the times at which the rays enter the node. */
+		static unsigned int _Intersect( const Node &node , const RayPacket &packet , const double position[3][ RayPacket::MaxSize ] , const double inverseDirection[3][ RayPacket::MaxSize ] , unsigned int mask , double t[ RayPacket::MaxSize ] , unsigned int tIdx );
+
+		/** This method returns the number of bits set in the mask. */
+		static unsigned int _BitCount( unsigned int mask );
+
+		/** This method returns the index of the lowest bit set in the (non-zero) mask. */
+		static unsigned int _LowestBit( unsigned int mask );
+	};
+
+	/** This class represents a bounding volume hierarchy over a triangle mesh.
+	*** The triangles are stored in structure-of-arrays form (reordered so that the triangles in a leaf are contiguous)
+	*** and the leaves are intersected with a batched Moller-Trumbore kernel. */
+	class TriangleBVH : public BVH
+	{
+	public:
+		/** The default number of triangles below which a node may become a leaf */
+		static const unsigned int DefaultLeafSize = 8;
+
+		/** The number of triangles that are intersected together */
+		static const unsigned int BatchSize = 8;
+
+		/** This method builds the hierarchy over the triangles.
+		*** The triangle function is called as triangle( i , p ) and should set p[0], p[1], and p[2] to the positions of the vertices of the i-th triangle.
+		*** If compact is set, the positions are stored in single precision (halving the memory used per triangle). The triangles are then culled in single precision
+		*** and only those that may be hit are intersected in double precision, so the results are the same as intersecting the rounded triangles in double precision. */
+		template< typename TriangleFunction >
+		void set( size_t triangleNum , TriangleFunction triangle , unsigned int leafSize=DefaultLeafSize , bool compact=false );
+
+		/** This method clears the hierarchy. */
+		void clear( void );
+
+		/** This method finds the closest triangle intersecting the ray within the range and passing the filter test.
+		*** If there is such an intersection, the method shrinks the range so that its upper end is the time of intersection,
+		*** sets the index of the triangle and the barycentric coordinates of the second and third vertices, and returns true. */
+		template< typename Filter >
+		bool intersect( const Util::Ray3D &ray , Util::BoundingBox1D &range , const Filter &filter , unsigned int &triangle , double &b1 , double &b2 , unsigned int tIdx ) const;
+
+		/** This method finds the closest triangles intersecting the active rays of the packet within their ranges, shrinking the ranges accordingly.
+		*** For every ray i with an intersection, the hit function is called (once) as hitFunction( i , triangle , b1 , b2 ). */
+		template< typename HitFunction >
+		void intersect( RayPacket &packet , HitFunction hitFunction , unsigned int tIdx ) const;
+
+		/** This method finds triangles intersecting the ray within the range and passing the filter test, in no particular order, without computing barycentric coordinates.
+		*** For every such triangle, the hit function is called as hitFunction( triangle ) and returns true if the search should continue.
+		*** The method returns true if the search was terminated by the hit function. */
+		template< typename Filter , typename HitFunction >
+		bool intersectAny( const Util::Ray3D &ray , Util::BoundingBox1D range , const Filter &filter , HitFunction hitFunction , unsigned int tIdx ) const;
+
+	protected:
+		/** This method finds the closest intersection of the ray with the triangles at the leaf positions [begin,end), as in the single-ray intersect method. */
+		template< typename Filter >
+		bool _intersect( const Util::Ray3D &ray , unsigned int begin , unsigned int end , Util::BoundingBox1D &range , const Filter &filter , unsigned int &triangle , double &b1 , double &b2 , unsigned int tIdx ) const;
+
+		/** This method computes the times of intersection (and barycentric coordinates) of the ray with the count <= BatchSize triangles starting at leaf position begin.
+		*** Triangles that are not intersected are assigned an infinite time. */
+		void _intersect( const Util::Ray3D &ray , unsigned int begin , unsigned int count , double t[BatchSize] , double u[BatchSize] , double v[BatchSize] ) const;
+
+		/** This method computes the times of intersection as above, using the single precision positions. */
+		void _intersectCompact( const Util::Ray3D &ray , unsigned int begin , unsigned int count , double t[BatchSize] , double u[BatchSize] , double v[BatchSize] ) const;
+
+		/** The first vertex and the two edges emanating from it, stored as nine arrays: { v0[x] , v0[y] , v0[z] , e1[x] , e1[y] , e1[z] , e2[x] , e2[y] , e2[z] } */
+		Util::AlignedVector< double > _soa[9];
+
+		/** The (single precision) positions of the three vertices, stored as three arrays: { v0 , v1 , v2 } (empty unless the hierarchy is compact).
+		*** Storing the vertices, rather than the edges, ensures that triangles sharing a vertex see the same rounded position. */
+		Util::AlignedVector< Util::Point3F > _compactVertices[3];
+
+		/** This method builds the hierarchy from the (unordered) structure-of-arrays and then reorders the arrays to match the leaves. */
+		void _set( unsigned int leafSize );
+	};
+}
+#include "bvh.inl"
+#endif // BVH_INCLUDED
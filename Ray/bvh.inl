@@ -0,0 +1,343 @@
+namespace Ray
+{
+	/////////
+	// BVH //
+	/////////
+	inline bool BVH::empty( void ) const { return _nodes.empty(); }
+
+	inline size_t BVH::size( void ) const { return _nodes.size(); }
+
+	inline const Util::AlignedVector< BVH::Node > &BVH::nodes( void ) const { return _nodes; }
+
+	inline unsigned int BVH::index( unsigned int i ) const { return _indices[i]; }
+
+	inline bool BVH::_Intersect( const Node &node , const Util::ReciprocalRay3D &ray , double tMin , double tMax , double &t , unsigned int tIdx )
+	{
+		RayTracingStats::IncrementRayBoundingBoxIntersectionNum( tIdx );
+		for( int d=0 ; d<3 ; d++ )
+		{
+			// The sign of the direction selects the entry and exit planes of the slab, so the times need not be sorted
+			double t0 = ( node.bBox[ ray.sign[d] ][d] - ray.position[d] ) * ray.inverseDirection[d];
+			double t1 = ( node.bBox[ 1-ray.sign[d] ][d] - ray.position[d] ) * ray.inverseDirection[d];
+			// If the ray is parallel to the slab and starts on its boundary, the times are undefined (NaN), the comparisons fail, and the slab imposes no constraint
+			tMin = t0>tMin ? t0 : tMin;
+			tMax = t1<tMax ? t1 : tMax;
+		}
+		t = tMin;
+		return tMin<=tMax;
+	}
+
+	inline unsigned int BVH::_Intersect( const Node &node , const RayPacket &packet , const double position[3][ RayPacket::MaxSize ] , const double inverseDirection[3][ RayPacket::MaxSize ] , unsigned int mask , double t[ RayPacket::MaxSize ] , unsigned int tIdx )
+	{
+		RayTracingStats::IncrementRayBoundingBoxIntersectionNum( tIdx , _BitCount( mask ) );
+		unsigned int hitMask = 0;
+		// Test all the rays (not just the active ones) so that the loop can be vectorized
+		for( unsigned int i=0 ; i<packet.size ; i++ )
+		{
+			double tMin = packet.ranges[i][0][0] , tMax = packet.ranges[i][1][0];
+			for( int d=0 ; d<3 ; d++ )
+			{
+				// As for a single ray, the entry and exit planes are selected by the sign of the direction,
+				// so that if a slab's times are undefined (NaN) the comparisons fail and the slab imposes no constraint
+				int sign = inverseDirection[d][i]<0 ? 1 : 0;
+				double t0 = ( node.bBox[ sign ][d] - position[d][i] ) * inverseDirection[d][i];
+				double t1 = ( node.bBox[ 1-sign ][d] - position[d][i] ) * inverseDirection[d][i];
+				tMin = t0>tMin ? t0 : tMin;
+				tMax = t1<tMax ? t1 : tMax;
+			}
+			hitMask |= ( tMin<=tMax ? 1u : 0u )<<i;
+			t[i] = tMin;
+		}
+		return hitMask & mask;
+	}
+
+	inline unsigned int BVH::_BitCount( unsigned int mask )
+	{
+		unsigned int count = 0;
+		for( ; mask ; mask &= mask-1 ) count++;
+		return count;
+	}
+
+	inline unsigned int BVH::_LowestBit( unsigned int mask )
+	{
+		unsigned int i = 0;
+		while( !( mask & (1<<i) ) ) i++;
+		return i;
+	}
+
+	template< typename LeafFunction >
+	bool BVH::traverse( const Util::Ray3D &ray , Util::BoundingBox1D &range , LeafFunction leafFunction , unsigned int tIdx ) const
+	{
+		if( _nodes.empty() ) return false;
+
+		Util::ReciprocalRay3D _ray( ray );
+		double t;
+		if( !_Intersect( _nodes[0] , _ray , range[0][0] , range[1][0] , t , tIdx ) ) return false;
+		return _traverse( 0 , t , _ray , range , leafFunction , tIdx );
+	}
+
+	template< typename LeafFunction >
+	bool BVH::_traverse( unsigned int root , double t , const Util::ReciprocalRay3D &ray , Util::BoundingBox1D &range , LeafFunction leafFunction , unsigned int tIdx ) const
+	{
+		struct StackEntry
+		{
+			unsigned int node;
+			double t;
+		};
+
+		StackEntry stack[ MaxDepth+1 ];
+		unsigned int stackSize = 0;
+		stack[ stackSize++ ] = { root , t };
+
+		while( stackSize )
+		{
+			StackEntry entry = stack[ --stackSize ];
+
+			// Skip the node if a closer intersection has been found since it was pushed
+			if( entry.t>range[1][0] ) continue;
+
+			const Node &node = _nodes[ entry.node ];
+			if( node.count )
+			{
+				if( leafFunction( node.offset , node.offset+node.count ) ) return true;
+			}
+			else
+			{
+				unsigned int c0 = entry.node+1 , c1 = node.offset;
+				double t0 , t1;
+				bool hit0 = _Intersect( _nodes[c0] , ray , range[0][0] , range[1][0] , t0 , tIdx );
+				bool hit1 = _Intersect( _nodes[c1] , ray , range[0][0] , range[1][0] , t1 , tIdx );
+
+				// Push the farther child first so that the nearer one is processed first
+				if( hit0 && hit1 )
+				{
+					if( t0<=t1 ) stack[ stackSize++ ] = { c1 , t1 } , stack[ stackSize++ ] = { c0 , t0 };
+					else         stack[ stackSize++ ] = { c0 , t0 } , stack[ stackSize++ ] = { c1 , t1 };
+				}
+				else if( hit0 ) stack[ stackSize++ ] = { c0 , t0 };
+				else if( hit1 ) stack[ stackSize++ ] = { c1 , t1 };
+			}
+		}
+		return false;
+	}
+
+	template< typename LeafFunction >
+	void BVH::traverse( RayPacket &packet , LeafFunction leafFunction , unsigned int tIdx ) const
+	{
+		struct StackEntry
+		{
+			unsigned int node , mask;
+		};
+
+		if( _nodes.empty() || !packet.mask ) return;
+
+		// Prepare the rays once (they are reused if the packet diverges) and store them in structure-of-arrays form so that the rays can be tested against a node together
+		Util::ReciprocalRay3D rays[ RayPacket::MaxSize ];
+		double position[3][ RayPacket::MaxSize ] , inverseDirection[3][ RayPacket::MaxSize ];
+		for( unsigned int i=0 ; i<packet.size ; i++ )
+		{
+			rays[i] = Util::ReciprocalRay3D( packet.rays[i] );
+			for( int d=0 ; d<3 ; d++ ) position[d][i] = rays[i].position[d] , inverseDirection[d][i] = rays[i].inverseDirection[d];
+		}
+
+		StackEntry stack[ MaxDepth+1 ];
+		unsigned int stackSize = 0;
+		stack[ stackSize++ ] = { 0 , packet.mask };
+
+		while( stackSize )
+		{
+			StackEntry entry = stack[ --stackSize ];
+			double t[ RayPacket::MaxSize ];
+			unsigned int mask = _Intersect( _nodes[ entry.node ] , packet , position , inverseDirection , entry.mask , t , tIdx );
+			if( !mask ) continue;
+
+			// If the packet has diverged, traverse the sub-tree with the remaining rays individually (starting from the node, which they are known to intersect)
+			if( _BitCount( mask )*PacketDivergenceRatio<=packet.size )
+			{
+				for( unsigned int i=0 ; i<packet.size ; i++ ) if( mask & (1<<i) )
+					_traverse( entry.node , t[i] , rays[i] , packet.ranges[i] , [&]( unsigned int begin , unsigned int end ){ leafFunction( begin , end , 1u<<i ) ; return false; } , tIdx );
+				continue;
+			}
+
+			const Node &node = _nodes[ entry.node ];
+			if( node.count ) leafFunction( node.offset , node.offset+node.count , mask );
+			else
+			{
+				// Since the rays are coherent, process the child on the side that the first active ray enters from first
+				unsigned int c0 = entry.node+1 , c1 = node.offset;
+				if( packet.rays[ _LowestBit( mask ) ].direction[ node.axis ]<0 ) std::swap( c0 , c1 );
+				stack[ stackSize++ ] = { c1 , mask } , stack[ stackSize++ ] = { c0 , mask };
+			}
+		}
+	}
+
+	/////////////////
+	// TriangleBVH //
+	/////////////////
+	template< typename TriangleFunction >
+	void TriangleBVH::set( size_t triangleNum , TriangleFunction triangle , unsigned int leafSize , bool compact )
+	{
+		for( int i=0 ; i<9 ; i++ ) _soa[i].resize( compact ? 0 : triangleNum );
+		for( int i=0 ; i<3 ; i++ ) _compactVertices[i].resize( compact ? triangleNum : 0 );
+		Util::Point3D p[3];
+		for( size_t i=0 ; i<triangleNum ; i++ )
+		{
+			triangle( i , p );
+			if( compact ) for( int j=0 ; j<3 ; j++ ) _compactVertices[j][i] = Util::Point3F( p[j] );
+			else
+			{
+				Util::Point3D e1 = p[1] - p[0] , e2 = p[2] - p[0];
+				for( int d=0 ; d<3 ; d++ ) _soa[d][i] = p[0][d] , _soa[3+d][i] = e1[d] , _soa[6+d][i] = e2[d];
+			}
+		}
+		_set( leafSize );
+	}
+
+	template< typename Filter >
+	bool TriangleBVH::intersect( const Util::Ray3D &ray , Util::BoundingBox1D &range , const Filter &filter , unsigned int &triangle , double &b1 , double &b2 , unsigned int tIdx ) const
+	{
+		bool hit = false;
+		traverse( ray , range , [&]( unsigned int begin , unsigned int end )
+		{
+			if( _intersect( ray , begin , end , range , filter , triangle , b1 , b2 , tIdx ) ) hit = true;
+			return false;
+		} , tIdx );
+		return hit;
+	}
+
+	template< typename HitFunction >
+	void TriangleBVH::intersect( RayPacket &packet , HitFunction hitFunction , unsigned int tIdx ) const
+	{
+		static const auto Accept = []( double ){ return true; };
+		unsigned int triangles[ RayPacket::MaxSize ] , hitMask = 0;
+		double b1[ RayPacket::MaxSize ] , b2[ RayPacket::MaxSize ];
+
+		traverse( packet , [&]( unsigned int begin , unsigned int end , unsigned int mask )
+		{
+			for( unsigned int i=0 ; i<packet.size ; i++ ) if( ( mask & (1<<i) ) && _intersect( packet.rays[i] , begin , end , packet.ranges[i] , Accept , triangles[i] , b1[i] , b2[i] , tIdx ) ) hitMask |= 1<<i;
+		} , tIdx );
+
+		for( unsigned int i=0 ; i<packet.size ; i++ ) if( hitMask & (1<<i) ) hitFunction( i , triangles[i] , b1[i] , b2[i] );
+	}
+
+	template< typename Filter , typename HitFunction >
+	bool TriangleBVH::intersectAny( const Util::Ray3D &ray , Util::BoundingBox1D range , const Filter &filter , HitFunction hitFunction , unsigned int tIdx ) const
+	{
+		// Since the range is never shrunk, the order in which the leaves are visited does not matter
+		return traverse( ray , range , [&]( unsigned int begin , unsigned int end )
+		{
+			RayTracingStats::IncrementRayPrimitiveIntersectionNum( tIdx , end-begin );
+			for( unsigned int b=begin ; b<end ; b+=BatchSize )
+			{
+				double t[BatchSize] , u[BatchSize] , v[BatchSize];
+				const unsigned int count = end-b<BatchSize ? end-b : BatchSize;
+				_intersect( ray , b , count , t , u , v );
+				for( unsigned int j=0 ; j<count ; j++ ) if( t[j]>range[0][0] && t[j]<range[1][0] && filter( t[j] ) && !hitFunction( index( b+j ) ) ) return true;
+			}
+			return false;
+		} , tIdx );
+	}
+
+	inline void TriangleBVH::_intersect( const Util::Ray3D &ray , unsigned int begin , unsigned int count , double t[BatchSize] , double u[BatchSize] , double v[BatchSize] ) const
+	{
+		if( !_compactVertices[0].empty() ) return _intersectCompact( ray , begin , count , t , u , v );
+
+		const double *v0x = &_soa[0][begin] , *v0y = &_soa[1][begin] , *v0z = &_soa[2][begin];
+		const double *e1x = &_soa[3][begin] , *e1y = &_soa[4][begin] , *e1z = &_soa[5][begin];
+		const double *e2x = &_soa[6][begin] , *e2y = &_soa[7][begin] , *e2z = &_soa[8][begin];
+		const double ox = ray.position[0] , oy = ray.position[1] , oz = ray.position[2];
+		const double dx = ray.direction[0] , dy = ray.direction[1] , dz = ray.direction[2];
+
+		// Compute the intersections with the whole batch before testing (so that the loop can be vectorized)
+		for( unsigned int i=0 ; i<count ; i++ )
+		{
+			// p = d x e2
+			double px = dy*e2z[i] - dz*e2y[i] , py = dz*e2x[i] - dx*e2z[i] , pz = dx*e2y[i] - dy*e2x[i];
+			double det = e1x[i]*px + e1y[i]*py + e1z[i]*pz;
+			double inv = det ? 1./det : 0.;
+			// s = o - v0
+			double sx = ox - v0x[i] , sy = oy - v0y[i] , sz = oz - v0z[i];
+			// q = s x e1
+			double qx = sy*e1z[i] - sz*e1y[i] , qy = sz*e1x[i] - sx*e1z[i] , qz = sx*e1y[i] - sy*e1x[i];
+			u[i] = ( sx*px + sy*py + sz*pz ) * inv;
+			v[i] = ( dx*qx + dy*qy + dz*qz ) * inv;
+			t[i] = ( e2x[i]*qx + e2y[i]*qy + e2z[i]*qz ) * inv;
+			if( !det || u[i]<0 || v[i]<0 || u[i]+v[i]>1 ) t[i] = Util::Infinity;
+		}
+	}
+
+	inline void TriangleBVH::_intersectCompact( const Util::Ray3D &ray , unsigned int begin , unsigned int count , double t[BatchSize] , double u[BatchSize] , double v[BatchSize] ) const
+	{
+		const Util::Point3F *v0 = &_compactVertices[0][begin] , *v1 = &_compactVertices[1][begin] , *v2 = &_compactVertices[2][begin];
+		const Util::Ray3F fRay( ray );
+		const float eps = Util::Tolerance< float >::Epsilon();
+		const float fox = fRay.position[0] , foy = fRay.position[1] , foz = fRay.position[2];
+		const float fdx = fRay.direction[0] , fdy = fRay.direction[1] , fdz = fRay.direction[2];
+		const float oScale = fabsf( fox ) + fabsf( foy ) + fabsf( foz ) , dScale = fabsf( fdx ) + fabsf( fdy ) + fabsf( fdz );
+		bool candidate[BatchSize];
+
+		// Cull the batch in single precision (twice as many lanes as in double precision). The culling is conservative:
+		// the tests are relaxed by a bound on the rounding error, so that no triangle that is hit in double precision is culled.
+		for( unsigned int i=0 ; i<count ; i++ )
+		{
+			float e1x = v1[i][0] - v0[i][0] , e1y = v1[i][1] - v0[i][1] , e1z = v1[i][2] - v0[i][2];
+			float e2x = v2[i][0] - v0[i][0] , e2y = v2[i][1] - v0[i][1] , e2z = v2[i][2] - v0[i][2];
+			float px = fdy*e2z - fdz*e2y , py = fdz*e2x - fdx*e2z , pz = fdx*e2y - fdy*e2x;
+			float det = e1x*px + e1y*py + e1z*pz;
+			float sx = fox - v0[i][0] , sy = foy - v0[i][1] , sz = foz - v0[i][2];
+			float qx = sy*e1z - sz*e1y , qy = sz*e1x - sx*e1z , qz = sx*e1y - sy*e1x;
+			// The barycentric coordinates scaled by the determinant
+			float uDet = sx*px + sy*py + sz*pz , vDet = fdx*qx + fdy*qy + fdz*qz;
+			if( det<0 ) det = -det , uDet = -uDet , vDet = -vDet;
+
+			float e1Scale = fabsf( e1x ) + fabsf( e1y ) + fabsf( e1z ) , e2Scale = fabsf( e2x ) + fabsf( e2y ) + fabsf( e2z );
+			float sScale = oScale + fabsf( v0[i][0] ) + fabsf( v0[i][1] ) + fabsf( v0[i][2] );
+			float detTol = eps * e1Scale * dScale * e2Scale , uTol = eps * sScale * dScale * e2Scale , vTol = eps * sScale * e1Scale * dScale;
+			// If the determinant is within the rounding error of zero, its sign is unreliable, so the triangle is not culled
+			candidate[i] = det<=detTol || ( uDet>=-uTol && vDet>=-vTol && uDet+vDet<=det+detTol+uTol+vTol );
+		}
+
+		const double ox = ray.position[0] , oy = ray.position[1] , oz = ray.position[2];
+		const double dx = ray.direction[0] , dy = ray.direction[1] , dz = ray.direction[2];
+		for( unsigned int i=0 ; i<count ; i++ )
+		{
+			t[i] = Util::Infinity;
+			if( !candidate[i] ) continue;
+			// The edges are computed in double precision from the rounded vertices, so only the storage loses precision
+			double e1x = (double)v1[i][0] - v0[i][0] , e1y = (double)v1[i][1] - v0[i][1] , e1z = (double)v1[i][2] - v0[i][2];
+			double e2x = (double)v2[i][0] - v0[i][0] , e2y = (double)v2[i][1] - v0[i][1] , e2z = (double)v2[i][2] - v0[i][2];
+			double px = dy*e2z - dz*e2y , py = dz*e2x - dx*e2z , pz = dx*e2y - dy*e2x;
+			double det = e1x*px + e1y*py + e1z*pz;
+			if( !det ) continue;
+			double inv = 1./det;
+			double sx = ox - v0[i][0] , sy = oy - v0[i][1] , sz = oz - v0[i][2];
+			double qx = sy*e1z - sz*e1y , qy = sz*e1x - sx*e1z , qz = sx*e1y - sy*e1x;
+			u[i] = ( sx*px + sy*py + sz*pz ) * inv;
+			v[i] = ( dx*qx + dy*qy + dz*qz ) * inv;
+			if( u[i]<0 || v[i]<0 || u[i]+v[i]>1 ) continue;
+			t[i] = ( e2x*qx + e2y*qy + e2z*qz ) * inv;
+		}
+	}
+
+	template< typename Filter >
+	bool TriangleBVH::_intersect( const Util::Ray3D &ray , unsigned int begin , unsigned int end , Util::BoundingBox1D &range , const Filter &filter , unsigned int &triangle , double &b1 , double &b2 , unsigned int tIdx ) const
+	{
+		bool hit = false;
+
+		RayTracingStats::IncrementRayPrimitiveIntersectionNum( tIdx , end-begin );
+		for( unsigned int b=begin ; b<end ; b+=BatchSize )
+		{
+			double t[BatchSize] , u[BatchSize] , v[BatchSize];
+			const unsigned int count = end-b<BatchSize ? end-b : BatchSize;
+			_intersect( ray , b , count , t , u , v );
+
+			for( unsigned int j=0 ; j<count ; j++ ) if( t[j]>range[0][0] && t[j]<range[1][0] && filter( t[j] ) )
+			{
+				range[1][0] = t[j];
+				triangle = index( b+j ) , b1 = u[j] , b2 = v[j];
+				hit = true;
+			}
+		}
+		return hit;
+	}
+}
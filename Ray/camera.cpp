@@ -22,6 +22,11 @@ namespace Ray
 		return stream;
 	}
 
+	RayDifferential Camera::getRayDifferential( int i , int j , int width , int height ) const
+	{
+		return RayDifferential( getRay( i , j , width , height ) , getRay( i+1 , j , width , height ) , getRay( i , j+1 , width , height ) );
+	}
+
 	std::ostream &operator << ( std::ostream &stream , const Camera &camera )
 	{
 		return stream << "#camera  " << camera.position << "  " << camera.forward << "  " << camera.up << "  " << camera.heightAngle;
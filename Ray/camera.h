@@ -2,6 +2,7 @@
 #define CAMERA_INCLUDED
 #include <stdio.h>
 #include <Util/geometry.h>
+#include "rayDifferential.h"
 
 namespace Ray
 {
@@ -44,6 +45,9 @@ namespace Ray
 
 		/** This function returns the ray that leaves the camera and goes through pixel (i,j) of the view plane */
 		Util::Ray3D getRay( int i , int j , int width , int height ) const;
+
+		/** This function returns the differentials of the ray through pixel (i,j), obtained from the rays through the neighboring pixels */
+		RayDifferential getRayDifferential( int i , int j , int width , int height ) const;
 	};
 
 	/** This operator writes the camera out to a stream. */
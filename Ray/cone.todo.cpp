@@ -46,7 +46,7 @@ void Cone::initOpenGL( void )
 
 bool Cone::processFirstIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
-	RayTracingStats::IncrementRayPrimitiveIntersectionNum();
+	RayTracingStats::IncrementRayPrimitiveIntersectionNum( tIdx );
 	spInfo.material = _material;
 
 	/////////////////////////////////////////////////////////////
@@ -58,7 +58,7 @@ bool Cone::processFirstIntersection( const Ray3D &ray , const BoundingBox1D &ran
 
 int Cone::processAllIntersections( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
-	RayTracingStats::IncrementRayPrimitiveIntersectionNum();
+	RayTracingStats::IncrementRayPrimitiveIntersectionNum( tIdx );
 	spInfo.material = _material;
 
 	/////////////////////////////////////////////////////////////
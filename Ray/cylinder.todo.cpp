@@ -45,7 +45,7 @@ void Cylinder::initOpenGL( void )
 
 bool Cylinder::processFirstIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
-	RayTracingStats::IncrementRayPrimitiveIntersectionNum();
+	RayTracingStats::IncrementRayPrimitiveIntersectionNum( tIdx );
 	spInfo.material = _material;
 
 	/////////////////////////////////////////////////////////////
@@ -57,7 +57,7 @@ bool Cylinder::processFirstIntersection( const Ray3D &ray , const BoundingBox1D
 
 int Cylinder::processAllIntersections( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
-	RayTracingStats::IncrementRayPrimitiveIntersectionNum();
+	RayTracingStats::IncrementRayPrimitiveIntersectionNum( tIdx );
 	spInfo.material = _material;
 
 	/////////////////////////////////////////////////////////////
@@ -42,8 +42,10 @@ bool DirectionalLight::isInShadow( const RayShapeIntersectionInfo& iInfo , const
 	//////////////////////////////////////////////
 	// Determine if the light is in shadow here //
 	//////////////////////////////////////////////
-	WARN_ONCE( "method undefined" );
-	return false;
+	// Cast a ray from the point of intersection towards the light and check if anything lies in between
+	Ray3D ray( iInfo.position , -_direction.unit() );
+	BoundingBox1D range( Epsilon , Infinity );
+	return _Occluded( shape , ray , range , tIdx );
 }
 
 Point3D DirectionalLight::transparency( const RayShapeIntersectionInfo &iInfo , const Shape &shape , Point3D cLimit , unsigned int samples , unsigned int tIdx ) const
@@ -51,8 +53,9 @@ Point3D DirectionalLight::transparency( const RayShapeIntersectionInfo &iInfo ,
 	//////////////////////////////////////////////////////////
 	// Compute the transparency along the path to the light //
 	//////////////////////////////////////////////////////////
-	WARN_ONCE( "method undefined" );
-	return Point3D( 1. , 1. , 1. );
+	Ray3D ray( iInfo.position , -_direction.unit() );
+	BoundingBox1D range( Epsilon , Infinity );
+	return _Transmittance( shape , ray , range , cLimit , tIdx );
 }
 
 void DirectionalLight::drawOpenGL( int index , GLSLProgram * glslProgram ) const
@@ -44,6 +44,10 @@ int FileInstance::processAllIntersections( const Ray3D &ray , const BoundingBox1
 	return _file->processAllIntersections( ray , range , rFilter , rKernel , spInfo , tIdx );
 }
 
+void FileInstance::processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const { _file->processFirstIntersections( packet , rpKernel , spInfo , tIdx ); }
+
+bool FileInstance::processAnyIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const { return _file->processAnyIntersection( ray , range , rFilter , roKernel , spInfo , tIdx ); }
+
 void FileInstance::processOverlapping( const Filter &filter , const Kernel &kernel , ShapeProcessingInfo spInfo ) const { _file->processOverlapping( filter , kernel , spInfo ); }
 
 bool FileInstance::isInside( Point3D p ) const { return _file->isInside(p); }
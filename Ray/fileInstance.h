@@ -34,6 +34,8 @@ namespace Ray
 		void updateBoundingBox( void );
 		bool processFirstIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 		int processAllIntersections( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		void processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		bool processAnyIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 		void processOverlapping( const Filter &filter , const Kernel &kernel , ShapeProcessingInfo spInfo ) const;
 		bool isInside( Util::Point3D p ) const;
 		void drawOpenGL( GLSLProgram * glslProgram ) const;
@@ -61,6 +61,12 @@ namespace Ray
 		/** This method returns a reference to the DataType storing the current data for the specified dof  */
 		const DataType &current( const std::string &dofName ) const;
 
+		/** This method returns a reference to the DataType storing the current data for the dof with the specified index */
+		const DataType &current( int dof ) const;
+
+		/** This method returns the index of the specified dof */
+		int dof( const std::string &dofName ) const;
+
 		/** This templated method sets the evaluator using the prescribed type of parameter */
 		template< typename ParameterType >
 		void setEvaluator( void );
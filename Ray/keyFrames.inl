@@ -32,6 +32,17 @@ namespace Ray
 		return _currentValues[0];
 	}
 
+	template< typename DataType >
+	const DataType &KeyFrameData< DataType >::current( int dof ) const { return _currentValues[dof]; }
+
+	template< typename DataType >
+	int KeyFrameData< DataType >::dof( const std::string &dofName ) const
+	{
+		for( int i=0 ; i<_dofNames.size() ; i++ ) if( _dofNames[i]==dofName ) return i;
+		THROW( "could not find dof name: " , dofName );
+		return -1;
+	}
+
 	template< typename DataType >
 	template< typename ParameterType >
 	void KeyFrameData< DataType >::setEvaluator( void )
@@ -0,0 +1,33 @@
+#include <Util/exceptions.h>
+#include <Util/geometry.h>
+#include "light.h"
+#include "scene.h"
+
+using namespace Ray;
+using namespace Util;
+
+///////////
+// Light //
+///////////
+bool Light::_Occluded( const Shape &shape , Ray3D ray , BoundingBox1D range , unsigned int tIdx )
+{
+	RayTracingStats::IncrementRayNum( tIdx );
+	auto rFilter = []( double ){ return true; };
+	auto roKernel = []( const Material * ){ return false; };
+	return shape.processAnyIntersection( ray , range , rFilter , roKernel , Shape::ShapeProcessingInfo() , tIdx );
+}
+
+Point3D Light::_Transmittance( const Shape &shape , Ray3D ray , BoundingBox1D range , Point3D cLimit , unsigned int tIdx )
+{
+	RayTracingStats::IncrementRayNum( tIdx );
+	Point3D transmittance( 1. , 1. , 1. );
+	auto rFilter = []( double ){ return true; };
+	auto roKernel = [&]( const Material *material )
+	{
+		// The transparencies are multiplied, so the order in which the surfaces are reported does not matter
+		for( int d=0 ; d<3 ; d++ ) transmittance[d] *= material ? material->transparent[d] : 0.;
+		return transmittance[0]>=cLimit[0] || transmittance[1]>=cLimit[1] || transmittance[2]>=cLimit[2];
+	};
+	shape.processAnyIntersection( ray , range , rFilter , roKernel , Shape::ShapeProcessingInfo() , tIdx );
+	return transmittance;
+}
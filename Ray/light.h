@@ -25,6 +25,14 @@ namespace Ray
 		/** The specular color of the light source */
 		Util::Point3D _specular;
 
+		/** This static method returns true if the shape intersects the ray within the range (e.g. the segment from a point to the light).
+		*** The query stops at the first intersection found, without determining which intersection is closest. */
+		static bool _Occluded( const class Shape &shape , Util::Ray3D ray , Util::BoundingBox1D range , unsigned int tIdx );
+
+		/** This static method returns the product of the transparencies of the surfaces the ray passes through within the range.
+		*** The query stops once every channel of the product has fallen below cLimit. */
+		static Util::Point3D _Transmittance( const class Shape &shape , Util::Ray3D ray , Util::BoundingBox1D range , Util::Point3D cLimit , unsigned int tIdx );
+
 	public:
 		/** The destructor */
 		virtual ~Light( void ){}
@@ -42,8 +42,12 @@ bool PointLight::isInShadow( const RayShapeIntersectionInfo& iInfo , const Shape
 	//////////////////////////////////////////////
 	// Determine if the light is in shadow here //
 	//////////////////////////////////////////////
-	WARN_ONCE( "method undefined" );
-	return false;
+	// Cast a ray from the point of intersection towards the light and check if anything lies in between
+	Point3D v = _location - iInfo.position;
+	double distance = v.length();
+	Ray3D ray( iInfo.position , v / distance );
+	BoundingBox1D range( Epsilon , distance );
+	return _Occluded( shape , ray , range , tIdx );
 }
 
 Point3D PointLight::transparency( const RayShapeIntersectionInfo &iInfo , const Shape &shape , Point3D cLimit , unsigned int samples , unsigned int tIdx ) const
@@ -51,8 +55,11 @@ Point3D PointLight::transparency( const RayShapeIntersectionInfo &iInfo , const
 	//////////////////////////////////////////////////////////
 	// Compute the transparency along the path to the light //
 	//////////////////////////////////////////////////////////
-	WARN_ONCE( "method undefined" );
-	return Point3D( 1. , 1. , 1. );
+	Point3D v = _location - iInfo.position;
+	double distance = v.length();
+	Ray3D ray( iInfo.position , v / distance );
+	BoundingBox1D range( Epsilon , distance );
+	return _Transmittance( shape , ray , range , cLimit , tIdx );
 }
 
 void PointLight::drawOpenGL( int index , GLSLProgram * glslProgram ) const
@@ -0,0 +1,47 @@
+#ifndef RAY_DIFFERENTIAL_INCLUDED
+#define RAY_DIFFERENTIAL_INCLUDED
+#include <cmath>
+#include <algorithm>
+#include <Util/geometry.h>
+
+namespace Ray
+{
+	/** This class stores the differentials of a ray, the derivatives of its starting position and direction with respect to the (x,y) coordinates
+	*** of the image plane (following Igehy's "Tracing Ray Differentials"). They are propagated along with the ray through reflection and refraction,
+	*** and are used to estimate the footprint of a pixel on the surface that the ray hits (e.g. to choose the level of a mip-mapped texture).
+	*** The derivatives of the normal are not tracked, so curved surfaces are treated as locally flat.
+	*** The default constructor gives zero differentials (a footprint of zero, so textures are sampled at full resolution). */
+	class RayDifferential
+	{
+	public:
+		/** The derivatives of the starting position with respect to x and y */
+		Util::Point3D dPosition[2];
+
+		/** The derivatives of the direction with respect to x and y */
+		Util::Point3D dDirection[2];
+
+		/** The default constructor */
+		RayDifferential( void );
+
+		/** This constructor sets the differentials by finite differences, from the ray and the rays through the neighboring pixels in the x and y directions */
+		RayDifferential( const Util::Ray3D &ray , const Util::Ray3D &rayX , const Util::Ray3D &rayY );
+
+		/** This method returns the differentials of the ray transferred to the point ray(t) on a surface with the prescribed normal.
+		*** (The starting position of the transferred ray moves within the tangent plane of the surface.) */
+		RayDifferential transfer( const Util::Ray3D &ray , double t , Util::Point3D normal ) const;
+
+		/** This method returns the differentials of the ray (already transferred to the surface) after it is reflected about the normal n.
+		*** (Since the derivatives of the normal are not tracked, the reflected differentials do not depend on the direction of the ray.) */
+		RayDifferential reflect( Util::Point3D n ) const;
+
+		/** This method returns the differentials of the ray with direction v (already transferred to the surface) after it is refracted through the surface with normal n.
+		*** Here eta is the ratio of the indices of refraction and refract is the refracted direction, so that refract = eta * v - mu * n for some mu. */
+		RayDifferential refract( Util::Point3D v , Util::Point3D n , double eta , Util::Point3D refract ) const;
+
+		/** This method returns the width of the footprint in texture space, given the gradients of the two texture coordinates at the surface.
+		*** It should be called on differentials that have been transferred to the surface. */
+		double footprint( const Util::Point3D textureGradients[2] ) const;
+	};
+}
+#include "rayDifferential.inl"
+#endif // RAY_DIFFERENTIAL_INCLUDED
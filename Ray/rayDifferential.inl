@@ -0,0 +1,63 @@
+namespace Ray
+{
+	/////////////////////
+	// RayDifferential //
+	/////////////////////
+	inline RayDifferential::RayDifferential( void ){}
+
+	inline RayDifferential::RayDifferential( const Util::Ray3D &ray , const Util::Ray3D &rayX , const Util::Ray3D &rayY )
+	{
+		dPosition[0] = rayX.position - ray.position , dDirection[0] = rayX.direction - ray.direction;
+		dPosition[1] = rayY.position - ray.position , dDirection[1] = rayY.direction - ray.direction;
+	}
+
+	inline RayDifferential RayDifferential::transfer( const Util::Ray3D &ray , double t , Util::Point3D normal ) const
+	{
+		RayDifferential rd;
+		double dn = Util::Point3D::Dot( ray.direction , normal );
+		for( int i=0 ; i<2 ; i++ )
+		{
+			rd.dPosition[i] = dPosition[i] + dDirection[i] * t;
+			// Account for the change in the distance to the surface, so that the differential lies in the tangent plane
+			if( dn ) rd.dPosition[i] -= ray.direction * ( Util::Point3D::Dot( rd.dPosition[i] , normal ) / dn );
+			rd.dDirection[i] = dDirection[i];
+		}
+		return rd;
+	}
+
+	inline RayDifferential RayDifferential::reflect( Util::Point3D n ) const
+	{
+		RayDifferential rd;
+		for( int i=0 ; i<2 ; i++ )
+		{
+			rd.dPosition[i] = dPosition[i];
+			rd.dDirection[i] = dDirection[i] - n * ( 2. * Util::Point3D::Dot( dDirection[i] , n ) );
+		}
+		return rd;
+	}
+
+	inline RayDifferential RayDifferential::refract( Util::Point3D v , Util::Point3D n , double eta , Util::Point3D refract ) const
+	{
+		RayDifferential rd;
+		double vn = Util::Point3D::Dot( v , n ) , tn = Util::Point3D::Dot( refract , n );
+		// The derivative of mu = eta * <v,n> - <refract,n> with respect to <v,n>
+		double dMu = tn ? eta - eta*eta*vn/tn : 0.;
+		for( int i=0 ; i<2 ; i++ )
+		{
+			rd.dPosition[i] = dPosition[i];
+			rd.dDirection[i] = dDirection[i] * eta - n * ( dMu * Util::Point3D::Dot( dDirection[i] , n ) );
+		}
+		return rd;
+	}
+
+	inline double RayDifferential::footprint( const Util::Point3D textureGradients[2] ) const
+	{
+		double width = 0;
+		for( int i=0 ; i<2 ; i++ )
+		{
+			double du = Util::Point3D::Dot( textureGradients[0] , dPosition[i] ) , dv = Util::Point3D::Dot( textureGradients[1] , dPosition[i] );
+			width = std::max< double >( width , sqrt( du*du + dv*dv ) );
+		}
+		return width;
+	}
+}
@@ -0,0 +1,16 @@
+#include "sampler.h"
+
+using namespace Ray;
+
+/////////////
+// Sampler //
+/////////////
+const std::vector< std::string > Sampler::SamplerNames = { "random" , "sobol" };
+
+Sampler::SamplerType Sampler::Type = Sampler::SOBOL;
+
+unsigned int Sampler::PilotSamples = 4;
+
+std::vector< Sampler > Sampler::_Samplers( 1 );
+
+void Sampler::Reserve( unsigned int threadNum ){ if( threadNum>_Samplers.size() ) _Samplers.resize( threadNum ); }
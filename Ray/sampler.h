@@ -0,0 +1,88 @@
+#ifndef SAMPLER_INCLUDED
+#define SAMPLER_INCLUDED
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+#include <algorithm>
+#include <Util/geometry.h>
+
+namespace Ray
+{
+	/** This class generates the two-dimensional sample points used for integrating over area light sources (and other domains).
+	*** Samples are drawn in sets, each started by a call to start(). With the SOBOL sampler the points of a set are the (0,2)-sequence
+	*** formed by the first two Sobol dimensions, randomized by a digital (XOR) scramble, so that the first 2^k points of a set are stratified
+	*** over every elementary interval of area 2^{-k}. With the RANDOM sampler the points are independent and uniformly distributed.
+	*** The scrambles and random seeds are derived from the pixel and the index of the set, so a rendering is deterministic regardless of the thread that traces a pixel.
+	*** There is one sampler per thread, accessed through Sampler::Get( tIdx ), and the samplers are (re)sized by the Scene before it is ray-traced. */
+	class Sampler
+	{
+	public:
+		enum SamplerType
+		{
+			RANDOM ,
+			SOBOL
+		};
+		static const std::vector< std::string > SamplerNames;
+
+		/** The type of sampler used */
+		static SamplerType Type;
+
+		/** The number of samples in the pilot set used by adaptive integration (or zero if integration should not be adaptive) */
+		static unsigned int PilotSamples;
+
+		/** The default constructor */
+		Sampler( void );
+
+		/** This method sets the pixel (and the index of the sample within the pixel) that is being traced, resetting the sequence of sets. */
+		void setPixel( unsigned int i , unsigned int j , unsigned int sample=0 );
+
+		/** This method starts a new set of samples. */
+		void start( void );
+
+		/** This method returns the next sample point in the current set, in [0,1)^2. */
+		Util::Point2D next( void );
+
+		/** This method estimates the mean of the sample function over [0,1)^2, using a new set of (at most) samples points.
+		*** The sample function is called as sampleFunction( u ) and returns a Util::Point3D.
+		*** Integration is adaptive: after a pilot set, it stops if all the values agree (e.g. the point is fully lit or fully occluded)
+		*** and otherwise keeps doubling the number of samples until the standard error of the mean is no larger than the tolerance in every channel.
+		*** (Stopping only at powers of two times the pilot size preserves the stratification of the SOBOL sampler.) */
+		template< typename SampleFunction >
+		Util::Point3D integrate( unsigned int samples , SampleFunction sampleFunction , Util::Point3D tolerance );
+
+		/** This static method returns the sampler associated with the thread. */
+		static Sampler &Get( unsigned int tIdx );
+
+		/** This static method ensures that there are samplers for (at least) the prescribed number of threads.
+		*** It should not be called while other threads are using the samplers. */
+		static void Reserve( unsigned int threadNum );
+
+		/** This static method returns the index-th point of the (0,2)-sequence, with the coordinates scrambled by XOR-ing with the prescribed values. */
+		static Util::Point2D Sobol( uint32_t index , uint32_t scramble0 , uint32_t scramble1 );
+
+	protected:
+		/** The seed of the current pixel */
+		uint32_t _seed;
+
+		/** The index of the current set */
+		uint32_t _set;
+
+		/** The index of the next sample in the current set */
+		uint32_t _index;
+
+		/** The scrambles of the current set */
+		uint32_t _scramble[2];
+
+		/** The generator used for the RANDOM sampler */
+		std::minstd_rand _generator;
+
+		/** This static method returns a hash of the value (with good avalanche behavior). */
+		static uint32_t _Hash( uint32_t value );
+
+		/** The samplers, indexed by thread */
+		static std::vector< Sampler > _Samplers;
+	};
+}
+#include "sampler.inl"
+#endif // SAMPLER_INCLUDED
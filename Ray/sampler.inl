@@ -0,0 +1,91 @@
+namespace Ray
+{
+	/////////////
+	// Sampler //
+	/////////////
+	inline Sampler::Sampler( void ) : _seed(0) , _set(0) , _index(0) { _scramble[0] = _scramble[1] = 0; }
+
+	inline void Sampler::setPixel( unsigned int i , unsigned int j , unsigned int sample ){ _seed = _Hash( _Hash( _Hash( i ) ^ j ) ^ sample ) , _set = 0 , _index = 0; }
+
+	inline void Sampler::start( void )
+	{
+		uint32_t hash = _Hash( _seed ^ _Hash( _set++ ) );
+		_index = 0;
+		if( Type==RANDOM ) _generator.seed( hash ? hash : 1 );
+		else _scramble[0] = hash , _scramble[1] = _Hash( hash );
+	}
+
+	inline Util::Point2D Sampler::next( void )
+	{
+		if( Type==RANDOM )
+		{
+			std::uniform_real_distribution< double > distribution( 0. , 1. );
+			double x = distribution( _generator );
+			return Util::Point2D( x , distribution( _generator ) );
+		}
+		else return Sobol( _index++ , _scramble[0] , _scramble[1] );
+	}
+
+	template< typename SampleFunction >
+	Util::Point3D Sampler::integrate( unsigned int samples , SampleFunction sampleFunction , Util::Point3D tolerance )
+	{
+		if( !samples ) return Util::Point3D();
+		start();
+
+		Util::Point3D sum , squareSum , first;
+		bool agree = true;
+		unsigned int n = 0 , checkpoint = PilotSamples ? PilotSamples : samples;
+		while( n<samples )
+		{
+			Util::Point3D value = sampleFunction( next() );
+			if( !n ) first = value;
+			for( int d=0 ; d<3 ; d++ )
+			{
+				if( value[d]!=first[d] ) agree = false;
+				sum[d] += value[d] , squareSum[d] += value[d]*value[d];
+			}
+			if( ++n==checkpoint && n<samples )
+			{
+				if( agree ) break;
+				bool converged = n>1;
+				for( int d=0 ; d<3 && converged ; d++ )
+				{
+					// The squared standard error of the mean is the sample variance divided by the number of samples
+					double mean = sum[d]/n , variance = std::max< double >( 0. , squareSum[d]/n - mean*mean ) * n / ( n-1 );
+					if( variance/n>tolerance[d]*tolerance[d] ) converged = false;
+				}
+				if( converged ) break;
+				checkpoint *= 2;
+			}
+		}
+		return sum / n;
+	}
+
+	inline Sampler &Sampler::Get( unsigned int tIdx ){ return _Samplers[tIdx]; }
+
+	inline Util::Point2D Sampler::Sobol( uint32_t index , uint32_t scramble0 , uint32_t scramble1 )
+	{
+		// The first dimension is the van der Corput sequence (the bit-reversal of the index)
+		uint32_t x = index;
+		x = ( x<<16 ) | ( x>>16 );
+		x = ( ( x & 0x00ff00ff )<<8 ) | ( ( x & 0xff00ff00 )>>8 );
+		x = ( ( x & 0x0f0f0f0f )<<4 ) | ( ( x & 0xf0f0f0f0 )>>4 );
+		x = ( ( x & 0x33333333 )<<2 ) | ( ( x & 0xcccccccc )>>2 );
+		x = ( ( x & 0x55555555 )<<1 ) | ( ( x & 0xaaaaaaaa )>>1 );
+
+		// The second dimension is generated by the (upper-triangular Pascal) direction numbers v_{k+1} = v_k ^ ( v_k>>1 )
+		uint32_t y = 0;
+		for( uint32_t v=1u<<31 ; index ; index>>=1 , v^=v>>1 ) if( index & 1 ) y ^= v;
+
+		static const double Scale = 1./4294967296.;
+		return Util::Point2D( ( x^scramble0 ) * Scale , ( y^scramble1 ) * Scale );
+	}
+
+	inline uint32_t Sampler::_Hash( uint32_t value )
+	{
+		value ^= value>>16 , value *= 0x7feb352d;
+		value ^= value>>15 , value *= 0x846ca68b;
+		value ^= value>>16;
+		return value;
+	}
+}
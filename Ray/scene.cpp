@@ -1,14 +1,30 @@
 #include <fstream>
 #include <cctype>
 #include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <clocale>
+#include <atomic>
+#include <sstream>
+#include <limits>
+#include <unordered_set>
 #include <Util/exceptions.h>
 #include <Util/cmdLineParser.h>
 #include <Util/ProgressBar.h>
+#include <Util/binaryStream.h>
 #include <Image/bmp.h>
 #include "scene.h"
 #include "fileInstance.h"
 #include "shapeList.h"
 #include <Util/threads.h>
+#if defined( _WIN32 ) || defined( _WIN64 )
+#include <windows.h>
+#elif defined( __APPLE__ )
+#include <xlocale.h>
+#endif // _WIN32 || _WIN64
 
 using namespace std;
 using namespace Ray;
@@ -19,14 +35,17 @@ namespace Ray
 {
 	string ReadDirective( istream &stream )
 	{
+		// The characters are read directly from the stream buffer, rather than through the stream (which constructs a sentry for every character)
+		streambuf *buffer = stream.rdbuf();
 		string directive;
 		int c;
 		// Ignore initial white-space
-		while( isspace( c=stream.get() ) ) ;
+		while( isspace( c=buffer->sbumpc() ) ) ;
+		if( c==EOF ) stream.setstate( ios::eofbit );
 		// If the string does not start with a "#" character or "//", throw an error
 		if( c=='/' )
 		{
-			c=stream.get();
+			c=buffer->sbumpc();
 			if( c=='/' )
 			{
 				string comment;
@@ -37,12 +56,9 @@ namespace Ray
 		}
 		else if( c=='#' ) ;
 		else THROW( "directive must start with a \'#\' " , (char)c );
-		// Initialize the string
-		directive.resize(0);
-		// Read in the characters, one by one, until the first white-space character is reached
-		while( !isspace( c=stream.get() ) ) directive.push_back( c );
-		// The last character read was not a white-space character, so put it back
-		stream.unget();
+		// Read in the characters, one by one, until the first white-space character is reached (leaving the white-space character in the stream)
+		while( ( c=buffer->sgetc() )!=EOF && !isspace( c ) ) directive.push_back( (char)buffer->sbumpc() );
+		if( c==EOF ) stream.setstate( ios::eofbit );
 		return directive;
 	}
 
@@ -73,6 +89,26 @@ namespace Ray
 	}
 }
 
+/** This function writes the text form of the object out to a stream in binary, with enough digits that the values are recovered exactly. */
+template< typename T >
+static void WriteText( ostream &stream , const T &t )
+{
+	ostringstream sStream;
+	sStream.precision( numeric_limits< double >::max_digits10 );
+	sStream << t;
+	Util::WriteBinary( stream , sStream.str() );
+}
+
+/** This function reads text written by WriteText in from a stream, setting the string stream to the text and returning the directive at its start. */
+static string ReadText( istream &stream , istringstream &sStream )
+{
+	string text;
+	Util::ReadBinary( stream , text );
+	sStream.clear();
+	sStream.str( text );
+	return ReadDirective( sStream );
+}
+
 //////////////////////////////
 // RayShapeIntersectionInfo //
 //////////////////////////////
@@ -111,6 +147,47 @@ GlobalSceneData::GlobalSceneData( void ) : shader(NULL) {}
 
 GlobalSceneData::~GlobalSceneData( void ){ if( shader ) delete shader; }
 
+void GlobalSceneData::writeBinary( ostream &stream ) const
+{
+	WriteText( stream , camera );
+	Util::WriteBinary( stream , (uint8_t)( shader ? 1 : 0 ) );
+	if( shader ) WriteText( stream , *shader );
+	Util::WriteBinary( stream , (uint64_t)lights.size() );
+	for( int i=0 ; i<lights.size() ; i++ ) WriteText( stream , *lights[i] );
+}
+
+void GlobalSceneData::readBinary( istream &stream )
+{
+	istringstream sStream;
+	string keyword;
+
+	if( ( keyword=ReadText( stream , sStream ) )!="camera" ) THROW( "expected camera: " , keyword );
+	sStream >> camera;
+
+	uint8_t hasShader;
+	Util::ReadBinary( stream , hasShader );
+	if( hasShader )
+	{
+		if( ( keyword=ReadText( stream , sStream ) )!="shader" ) THROW( "expected shader: " , keyword );
+		if( shader ) delete shader;
+		shader = new Shader();
+		if( !shader ) THROW( "failed to allocate memory for " , keyword );
+		sStream >> *shader;
+	}
+
+	uint64_t count;
+	Util::ReadBinary( stream , count );
+	for( uint64_t i=0 ; i<count ; i++ )
+	{
+		keyword = ReadText( stream , sStream );
+		if( LightFactories.find( keyword )==LightFactories.end() ) THROW( "unexpected light directive: " , keyword );
+		Light *light = LightFactories[ keyword ]->create();
+		if( !light ) THROW( "failed to allocate memory for " , keyword );
+		sStream >> *light;
+		lights.push_back( light );
+	}
+}
+
 namespace Ray
 {
 	ostream &operator << ( ostream &stream , const GlobalSceneData &data )
@@ -168,16 +245,183 @@ LocalSceneData::LocalSceneData( void ) : keyFrameFile(NULL) {}
 
 LocalSceneData::~LocalSceneData( void ){ if( keyFrameFile ) delete keyFrameFile; }
 
+void LocalSceneData::writeBinary( ostream &stream ) const
+{
+	Util::WriteBinary( stream , (uint64_t)textures.size() );
+	for( int i=0 ; i<textures.size() ; i++ ) WriteText( stream , textures[i] );
+
+	Util::WriteBinary( stream , (uint64_t)materials.size() );
+	for( int i=0 ; i<materials.size() ; i++ ) WriteText( stream , materials[i] );
+
+	Util::WriteBinary( stream , (uint64_t)files.size() );
+	for( int i=0 ; i<files.size() ; i++ )
+	{
+		Util::WriteBinary( stream , files[i].filename );
+		files[i].writeBinary( stream );
+	}
+
+	// The vertices are written as a single array of positions, normals, and texture coordinates
+	std::vector< double > values( vertices.size()*8 );
+	for( size_t i=0 ; i<vertices.size() ; i++ )
+	{
+		for( int d=0 ; d<3 ; d++ ) values[8*i+d] = vertices[i].position[d] , values[8*i+3+d] = vertices[i].normal[d];
+		for( int d=0 ; d<2 ; d++ ) values[8*i+6+d] = vertices[i].texCoordinate[d];
+	}
+	Util::WriteBinary( stream , values );
+
+	Util::WriteBinary( stream , (uint8_t)( keyFrameFile ? 1 : 0 ) );
+	if( keyFrameFile )
+	{
+		Util::WriteBinary( stream , keyFrameFile->filename );
+		WriteText( stream , keyFrameFile->keyFrameMatrices );
+	}
+}
+
+void LocalSceneData::readBinary( istream &stream )
+{
+	istringstream sStream;
+	string keyword;
+	uint64_t count;
+
+	Util::ReadBinary( stream , count );
+	textures.resize( (size_t)count );
+	for( size_t i=0 ; i<textures.size() ; i++ )
+	{
+		if( ( keyword=ReadText( stream , sStream ) )!="texture" ) THROW( "expected texture: " , keyword );
+		sStream >> textures[i];
+	}
+
+	Util::ReadBinary( stream , count );
+	materials.resize( (size_t)count );
+	for( size_t i=0 ; i<materials.size() ; i++ )
+	{
+		if( ( keyword=ReadText( stream , sStream ) )!="material" ) THROW( "expected material: " , keyword );
+		sStream >> materials[i];
+	}
+
+	Util::ReadBinary( stream , count );
+	files.resize( (size_t)count );
+	for( size_t i=0 ; i<files.size() ; i++ )
+	{
+		Util::ReadBinary( stream , files[i].filename );
+		files[i].readBinary( stream );
+	}
+
+	std::vector< double > values;
+	Util::ReadBinary( stream , values );
+	if( values.size()%8 ) THROW( "vertex value count is not a multiple of eight: " , values.size() );
+	vertices.resize( values.size()/8 );
+	for( size_t i=0 ; i<vertices.size() ; i++ )
+	{
+		for( int d=0 ; d<3 ; d++ ) vertices[i].position[d] = values[8*i+d] , vertices[i].normal[d] = values[8*i+3+d];
+		for( int d=0 ; d<2 ; d++ ) vertices[i].texCoordinate[d] = values[8*i+6+d];
+	}
+
+	uint8_t hasKeyFrameFile;
+	Util::ReadBinary( stream , hasKeyFrameFile );
+	if( hasKeyFrameFile )
+	{
+		if( keyFrameFile ) delete keyFrameFile;
+		keyFrameFile = new KeyFrameFile();
+		if( !keyFrameFile ) THROW( "failed to allocate KeyFrameFile" );
+		Util::ReadBinary( stream , keyFrameFile->filename );
+		string text;
+		Util::ReadBinary( stream , text );
+		sStream.clear();
+		sStream.str( text );
+		sStream >> keyFrameFile->keyFrameMatrices;
+		keyFrameFile->updateCurrentInverses();
+	}
+}
+
 void LocalSceneData::setCurrentTime( double t , int curveFit )
 {
 	if( keyFrameFile )
 	{
 		double tt = t/keyFrameFile->keyFrameMatrices.duration();
 		tt -= (int)tt;
-		keyFrameFile->keyFrameMatrices.setCurrentValues( tt , curveFit );
+		keyFrameFile->setCurrentValues( tt , curveFit );
 	}
 }
 
+/** This function parses a floating-point value as strtod does, but in the "C" locale (as stream extraction does) rather than the global one,
+*** so that the decimal separator does not depend on the locale the program runs in. */
+static double StrToD( const char *str , char **end )
+{
+#if defined( _WIN32 ) || defined( _WIN64 )
+	static const _locale_t locale = _create_locale( LC_NUMERIC , "C" );
+	return _strtod_l( str , end , locale );
+#else // !_WIN32 && !_WIN64
+	static const locale_t locale = newlocale( LC_NUMERIC_MASK , "C" , (locale_t)0 );
+	return strtod_l( str , end , locale );
+#endif // _WIN32 || _WIN64
+}
+
+/** This function reads a run of consecutive vertices (the first of whose directives has already been read) and appends them to the list.
+*** The text of the vertices is gathered first, and then parsed in parallel. */
+static void ReadVertices( istream &stream , std::vector< Vertex > &vertices )
+{
+	streambuf *buffer = stream.rdbuf();
+	string text , line;
+	std::vector< size_t > offsets( 1 , 0 );
+
+	// Comments (running to the end of the line) are dropped, and the rest of the line is part of the current vertex
+	auto AppendLine = [&]( void )
+	{
+		size_t comment = line.find( "//" );
+		if( comment!=string::npos ) line.resize( comment );
+		text += line , text.push_back( '\n' );
+	};
+
+	std::getline( stream , line );
+	AppendLine();
+	while( true )
+	{
+		int c;
+		while( ( c=buffer->sgetc() )!=EOF && isspace( (unsigned char)c ) ) buffer->sbumpc();
+		if( c==EOF ) break;
+		else if( c=='#' )
+		{
+			// Stop at the first directive that is not a vertex
+			string directive = ReadDirective( stream );
+			if( directive!="vertex" ){ UnreadDirective( stream , directive ) ; break; }
+			offsets.push_back( text.size() );
+		}
+		std::getline( stream , line );
+		AppendLine();
+	}
+
+	size_t start = vertices.size();
+	vertices.resize( start + offsets.size() );
+	std::atomic< bool > failed( false );
+	std::atomic< size_t > unnormalized( 0 );
+	ThreadPool::Parallel_for( 0 , offsets.size() , [&]( unsigned int , size_t i )
+	{
+		const char *c = text.c_str() + offsets[i] , *end = text.c_str() + ( i+1<offsets.size() ? offsets[i+1] : text.size() );
+		double values[8];
+		for( int j=0 ; j<8 ; j++ )
+		{
+			char *_c;
+			values[j] = StrToD( c , &_c );
+			if( _c==c || _c>end ){ failed = true ; return; }
+			// Only accept decimal numbers (as stream extraction does), not the infinities, NaNs, and hexadecimal values that strtod also parses
+			for( ; c<_c ; c++ ) if( !isspace( (unsigned char)*c ) && !isdigit( (unsigned char)*c ) && *c!='+' && *c!='-' && *c!='.' && *c!='e' && *c!='E' ){ failed = true ; return; }
+		}
+		while( c<end && isspace( (unsigned char)*c ) ) c++;
+		if( c!=end ){ failed = true ; return; }
+
+		Vertex &vertex = vertices[start+i];
+		vertex.position = Point3D( values[0] , values[1] , values[2] );
+		vertex.normal = Point3D( values[3] , values[4] , values[5] );
+		vertex.texCoordinate = Point2D( values[6] , values[7] );
+		double sz = vertex.normal.length();
+		if( !sz ) unnormalized++;
+		else vertex.normal /= sz;
+	} );
+	if( failed ) THROW( "Failed to parse vertex" );
+	if( unnormalized ) WARN( "No normal specified for " , (size_t)unnormalized , " vertices" );
+}
+
 namespace Ray
 {
 	ostream &operator << ( ostream &stream , const LocalSceneData &data )
@@ -215,12 +459,7 @@ namespace Ray
 			}
 
 			// Reading the vertices
-			else if( keyword=="vertex" )
-			{
-				Vertex vertex;
-				stream >> vertex;
-				data.vertices.push_back( vertex );
-			}
+			else if( keyword=="vertex" ) ReadVertices( stream , data.vertices );
 
 			// Reading the included ray files
 			else if( keyword=="ray_file" )
@@ -285,6 +524,11 @@ namespace Ray
 		if( !( stream >> texture._filename ) ) THROW( "Failed to parse texture" );
 		std::string fileName = GetFileName( Scene::BaseDir , texture._filename );
 		texture._image.read( fileName );
+		// The image itself stays in row-major order (so that its pixels can be accessed directly), and texture filtering, which accesses pixels that are close in the image, uses a tiled copy
+		texture._image.setLayout( Image32::ROW_MAJOR );
+		texture._samplingImage = texture._image;
+		texture._samplingImage.setLayout( Image32::TILED );
+		texture._setMipMaps();
 		return stream;
 	}
 
@@ -294,6 +538,65 @@ namespace Ray
 	}
 }
 
+void Texture::_setMipMaps( void )
+{
+	_mipMaps.clear();
+	const Image32 *image = &_samplingImage;
+	while( image->width()>1 || image->height()>1 )
+	{
+		// Each pixel of the next level is the average of (up to) a 2 x 2 block of pixels, with the blocks on the boundary clamped when a dimension is odd
+		int w = image->width() , h = image->height() , _w = std::max< int >( (w+1)/2 , 1 ) , _h = std::max< int >( (h+1)/2 , 1 );
+		Image32 mipMap;
+		mipMap.setLayout( Image32::TILED );
+		mipMap.setSize( _w , _h );
+		for( int y=0 ; y<_h ; y++ ) for( int x=0 ; x<_w ; x++ )
+		{
+			int x0 = std::min< int >( 2*x , w-1 ) , x1 = std::min< int >( 2*x+1 , w-1 ) , y0 = std::min< int >( 2*y , h-1 ) , y1 = std::min< int >( 2*y+1 , h-1 );
+			const Pixel32 &p00 = (*image)(x0,y0) , &p10 = (*image)(x1,y0) , &p01 = (*image)(x0,y1) , &p11 = (*image)(x1,y1);
+			Pixel32 &p = mipMap(x,y);
+			p.r = (unsigned char)( ( (int)p00.r + p10.r + p01.r + p11.r + 2 ) / 4 );
+			p.g = (unsigned char)( ( (int)p00.g + p10.g + p01.g + p11.g + 2 ) / 4 );
+			p.b = (unsigned char)( ( (int)p00.b + p10.b + p01.b + p11.b + 2 ) / 4 );
+			p.a = (unsigned char)( ( (int)p00.a + p10.a + p01.a + p11.a + 2 ) / 4 );
+		}
+		_mipMaps.push_back( std::move( mipMap ) );
+		image = &_mipMaps.back();
+	}
+}
+
+Point3D Texture::_sample( unsigned int level , Point2D texture ) const
+{
+	const Image32 &image = level ? _mipMaps[level-1] : _samplingImage;
+	int w = image.width() , h = image.height();
+	if( !w || !h ) return Point3D();
+
+	// Pixel centers are at half-integer positions, and the coordinates wrap around
+	double x = texture[0]*w - 0.5 , y = texture[1]*h - 0.5;
+	double fx = floor( x ) , fy = floor( y );
+	double dx = x - fx , dy = y - fy;
+	auto Wrap = []( double v , int size ){ int i = (int)fmod( v , (double)size ) ; return i<0 ? i+size : i; };
+	int x0 = Wrap( fx , w ) , y0 = Wrap( fy , h ) , x1 = x0+1<w ? x0+1 : 0 , y1 = y0+1<h ? y0+1 : 0;
+	auto Color = [&]( int x , int y ){ const Pixel32 &p = image(x,y) ; return Point3D( p.r , p.g , p.b ); };
+	Point3D c = ( Color( x0 , y0 ) * (1.-dx) + Color( x1 , y0 ) * dx ) * (1.-dy) + ( Color( x0 , y1 ) * (1.-dx) + Color( x1 , y1 ) * dx ) * dy;
+	return c / 255.;
+}
+
+Point3D Texture::sample( Point2D texture , double width ) const
+{
+	// The level at which the footprint covers (roughly) one pixel
+	double level = width>0 ? log2( width * std::max< int >( _image.width() , _image.height() ) ) : 0.;
+	if( !( level>0 ) ) return _sample( 0 , texture );
+	if( level>=(double)_mipMaps.size() ) return _sample( (unsigned int)_mipMaps.size() , texture );
+	unsigned int l = (unsigned int)level;
+	double d = level - l;
+	return _sample( l , texture ) * (1.-d) + _sample( l+1 , texture ) * d;
+}
+
+Point3D Texture::sample( const RayShapeIntersectionInfo &iInfo , const RayDifferential &rDifferential ) const
+{
+	return sample( iInfo.texture , rDifferential.footprint( iInfo.textureGradients ) );
+}
+
 ////////////
 // Shader //
 ////////////
@@ -327,10 +630,10 @@ namespace Ray
 	istream &operator >> ( istream &stream , File &file )
 	{
 		if( !( stream >> file.filename ) ) THROW( "Failed to parse ray_file" );
-		ifstream _stream;
 		std::string filename = GetFileName( Scene::BaseDir , file.filename );
-		_stream.open( filename );
-		if( !_stream ) THROW( "Failed to open file for reading: " , filename );
+		MappedFile mappedFile( filename );
+		MemoryStreamBuffer buffer( mappedFile.data() , mappedFile.size() );
+		istream _stream( &buffer );
 		try{ _stream >> (SceneGeometry&)file; }
 		catch( Util::Exception e ){ THROW( "failed to read ray-file " , filename , ": " , e.what() ); }	
 		return stream;
@@ -345,6 +648,28 @@ namespace Ray
 //////////////////
 // KeyFrameFile //
 //////////////////
+void KeyFrameFile::setCurrentValues( double t , int curveType )
+{
+	keyFrameMatrices.setCurrentValues( t , curveType );
+	updateCurrentInverses();
+}
+
+void KeyFrameFile::updateCurrentInverses( void )
+{
+	// The inverses are computed once when the transformations change, rather than every time a ray passes through a dynamic transformation
+	_currentInverses.resize( keyFrameMatrices.dofs() );
+	_currentNormals.resize( keyFrameMatrices.dofs() );
+	for( int i=0 ; i<keyFrameMatrices.dofs() ; i++ )
+	{
+		if( !keyFrameMatrices.current(i).setInverse( _currentInverses[i] ) ) _currentInverses[i] = Matrix4D();
+		_currentNormals[i] = Matrix3D( _currentInverses[i].transpose() );
+	}
+}
+
+const Matrix4D &KeyFrameFile::currentInverse( const std::string &dofName ) const { return _currentInverses[ keyFrameMatrices.dof( dofName ) ]; }
+
+const Matrix3D &KeyFrameFile::currentNormal( const std::string &dofName ) const { return _currentNormals[ keyFrameMatrices.dof( dofName ) ]; }
+
 namespace Ray
 {
 	istream &operator >> ( istream &stream , KeyFrameFile &keyFrameFile )
@@ -355,6 +680,7 @@ namespace Ray
 		_stream.open( filename );
 		if( !_stream ) THROW( "Failed to open file for reading: " , filename );
 		_stream >> keyFrameFile.keyFrameMatrices;
+		keyFrameFile.updateCurrentInverses();
 		return stream;
 	}
 
@@ -381,6 +707,16 @@ int SceneGeometry::processAllIntersections( const Ray3D &ray , const BoundingBox
 	return _shapeList.processAllIntersections( ray , range , rFilter , rKernel , spInfo , tIdx );
 }
 
+void SceneGeometry::processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	_shapeList.processFirstIntersections( packet , rpKernel , spInfo , tIdx );
+}
+
+bool SceneGeometry::processAnyIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	return _shapeList.processAnyIntersection( ray , range , rFilter , roKernel , spInfo , tIdx );
+}
+
 void SceneGeometry::init( void )
 {
 	// Set the material / vertex pointers
@@ -467,6 +803,39 @@ void SceneGeometry::_read( istream &stream )
 	}
 }
 
+void SceneGeometry::writeBinary( ostream &stream ) const
+{
+	_localData.writeBinary( stream );
+	Util::WriteBinary( stream , (uint64_t)_shapeList.shapes.size() );
+	for( int i=0 ; i<_shapeList.shapes.size() ; i++ ) Shape::WriteBinary( stream , *_shapeList.shapes[i] );
+}
+
+void SceneGeometry::readBinary( istream &stream )
+{
+	_localData.readBinary( stream );
+	uint64_t count;
+	Util::ReadBinary( stream , count );
+	_shapeList.shapes.reserve( _shapeList.shapes.size() + (size_t)count );
+	for( uint64_t i=0 ; i<count ; i++ ) _shapeList.shapes.push_back( Shape::ReadBinary( stream ) );
+}
+
+void SceneGeometry::dependencies( std::vector< std::string > &fileNames ) const
+{
+	for( int i=0 ; i<_localData.files.size() ; i++ )
+	{
+		fileNames.push_back( GetFileName( Scene::BaseDir , _localData.files[i].filename ) );
+		_localData.files[i].dependencies( fileNames );
+	}
+	if( _localData.keyFrameFile ) fileNames.push_back( GetFileName( Scene::BaseDir , _localData.keyFrameFile->filename ) );
+}
+
+bool SceneGeometry::hasTextures( void ) const
+{
+	if( _localData.textures.size() ) return true;
+	for( int i=0 ; i<_localData.files.size() ; i++ ) if( _localData.files[i].hasTextures() ) return true;
+	return false;
+}
+
 void SceneGeometry::processOverlapping( const Filter &filter , const Kernel &kernel , ShapeProcessingInfo spInfo ) const { _shapeList.processOverlapping( filter , kernel , spInfo ); }
 
 ///////////
@@ -474,6 +843,37 @@ void SceneGeometry::processOverlapping( const Filter &filter , const Kernel &ker
 ///////////
 std::string Scene::BaseDir = "." + std::string( 1 , Util::FileSeparator );
 
+unsigned int Scene::TileSize = 16;
+
+unsigned int Scene::PacketSize = 1;
+
+unsigned int Scene::PixelSamples = 1;
+
+double Scene::PixelSampleThreshold = 0.1;
+
+unsigned int Scene::ProgressivePasses = 1;
+
+std::string Scene::CheckpointFile;
+
+std::string Scene::PreviewFile;
+
+bool Scene::UseCache = false;
+
+/** This function returns the Morton code of a 2D index, obtained by interleaving the bits of the two coordinates */
+static unsigned long long MortonCode( unsigned int x , unsigned int y )
+{
+	auto Spread = []( unsigned long long v )
+	{
+		v = ( v | ( v<<16 ) ) & 0x0000FFFF0000FFFFull;
+		v = ( v | ( v<< 8 ) ) & 0x00FF00FF00FF00FFull;
+		v = ( v | ( v<< 4 ) ) & 0x0F0F0F0F0F0F0F0Full;
+		v = ( v | ( v<< 2 ) ) & 0x3333333333333333ull;
+		v = ( v | ( v<< 1 ) ) & 0x5555555555555555ull;
+		return v;
+	};
+	return Spread( x ) | ( Spread( y )<<1 );
+}
+
 void Scene::initOpenGL( void )
 {
 	if( _globalData.shader && _globalData.shader->glslProgram ) _globalData.shader->glslProgram->init();
@@ -502,6 +902,161 @@ namespace Ray
 	}
 }
 
+/** This function moves the (temporary) file onto the target, replacing the target if it exists, and returns true if the move succeeded. */
+static bool MoveReplacing( const std::string &fileName , const std::string &targetFileName )
+{
+#if defined( _WIN32 ) || defined( _WIN64 )
+	// On Windows, rename fails if the target exists
+	return MoveFileExA( fileName.c_str() , targetFileName.c_str() , MOVEFILE_REPLACE_EXISTING )!=0;
+#else // !_WIN32 && !_WIN64
+	return std::rename( fileName.c_str() , targetFileName.c_str() )==0;
+#endif // _WIN32 || _WIN64
+}
+
+/** The header of a scene cache file, which is followed by the state of the files the scene was read from and the binary form of the scene.
+*** The version should be incremented whenever the binary form of the scene (or of any of its shapes, lights, or textures) changes, so that stale caches are ignored. */
+struct SceneCacheHeader
+{
+	char magic[8];
+	uint32_t version , reserved;
+	uint64_t size;
+};
+static const char SceneCacheMagic[8] = { 'R' , 'A' , 'Y' , 'S' , 'C' , 'A' , 'C' , 'H' };
+static const uint32_t SceneCacheVersion = 2;
+
+void Scene::read( const std::string &fileName )
+{
+	// The lights and shapes created while reading are constructed in (and owned by) the scene's storage
+	FactoryStorage::Binding factoryStorageBinding( _factoryStorage );
+
+	std::string cacheFileName = fileName + std::string( ".cache" );
+	if( UseCache && _readCache( cacheFileName ) )
+	{
+		init();
+		return;
+	}
+
+	// Parse the text directly from the mapped file
+	{
+		MappedFile file( fileName );
+		MemoryStreamBuffer buffer( file.data() , file.size() );
+		istream stream( &buffer );
+		stream >> *this;
+	}
+	if( UseCache ) _writeCache( cacheFileName , fileName );
+}
+
+void Scene::_writeCache( const std::string &cacheFileName , const std::string &fileName ) const
+{
+	std::vector< std::string > fileNames( 1 , fileName );
+	dependencies( fileNames );
+
+	// Write to a temporary file which then replaces the cache (so that a cache is never left partially written)
+	std::string tempFileName = cacheFileName + std::string( ".tmp" );
+	{
+		ofstream stream( tempFileName , std::ios::binary );
+		if( !stream ){ WARN( "Failed to open scene cache for writing: " , tempFileName ) ; return; }
+		SceneCacheHeader header;
+		memcpy( header.magic , SceneCacheMagic , sizeof(SceneCacheMagic) );
+		header.version = SceneCacheVersion , header.reserved = 0 , header.size = 0;
+		stream.write( (const char *)&header , sizeof(header) );
+
+		Util::WriteBinary( stream , (uint64_t)fileNames.size() );
+		for( size_t i=0 ; i<fileNames.size() ; i++ )
+		{
+			FileStamp stamp( fileNames[i] );
+			Util::WriteBinary( stream , fileNames[i] );
+			Util::WriteBinary( stream , stamp.time );
+			Util::WriteBinary( stream , stamp.size );
+			Util::WriteBinary( stream , FileStamp::Hash( fileNames[i] ) );
+		}
+		_globalData.writeBinary( stream );
+		SceneGeometry::writeBinary( stream );
+
+		// Record the total size, so that a truncated cache can be detected
+		header.size = (uint64_t)stream.tellp();
+		stream.seekp( 0 );
+		stream.write( (const char *)&header , sizeof(header) );
+		if( !stream ){ WARN( "Failed to write scene cache: " , tempFileName ) ; return; }
+	}
+	if( !MoveReplacing( tempFileName , cacheFileName ) ) WARN( "Failed to replace scene cache: " , cacheFileName );
+}
+
+bool Scene::_readCache( const std::string &cacheFileName )
+{
+	if( !ifstream( cacheFileName , std::ios::binary ) ) return false;
+
+	MappedFile file( cacheFileName );
+	SceneCacheHeader header;
+	if( file.size()<sizeof(header) || memcmp( file.data() , SceneCacheMagic , sizeof(SceneCacheMagic) ) )
+	{
+		WARN( "Ignoring malformed scene cache: " , cacheFileName );
+		return false;
+	}
+	memcpy( &header , file.data() , sizeof(header) );
+	if( header.version!=SceneCacheVersion )
+	{
+		WARN( "Ignoring scene cache with version " , header.version , " (expected " , SceneCacheVersion , "): " , cacheFileName );
+		return false;
+	}
+	if( header.size!=file.size() )
+	{
+		WARN( "Ignoring truncated scene cache: " , cacheFileName );
+		return false;
+	}
+
+	MemoryStreamBuffer buffer( file.data()+sizeof(header) , file.size()-sizeof(header) );
+	istream stream( &buffer );
+
+	try
+	{
+		// Check that none of the files has changed, comparing the contents only if the time-stamp has changed but the size has not
+		uint64_t count;
+		Util::ReadBinary( stream , count );
+		for( uint64_t i=0 ; i<count ; i++ )
+		{
+			std::string fileName;
+			int64_t time;
+			uint64_t size , hash;
+			Util::ReadBinary( stream , fileName );
+			Util::ReadBinary( stream , time );
+			Util::ReadBinary( stream , size );
+			Util::ReadBinary( stream , hash );
+			try
+			{
+				FileStamp stamp( fileName );
+				if( stamp.size!=size || ( stamp.time!=time && FileStamp::Hash( fileName )!=hash ) ) return false;
+			}
+			catch( const Util::Exception & ){ return false; }
+		}
+
+		_globalData.readBinary( stream );
+		SceneGeometry::readBinary( stream );
+	}
+	catch( const std::exception &e )
+	{
+		// Discard whatever was read before the failure, so that the scene can be parsed from the text instead
+		WARN( "Ignoring unreadable scene cache: " , cacheFileName , " (" , e.what() , ")" );
+		_clear();
+		return false;
+	}
+	return true;
+}
+
+void Scene::_clear( void )
+{
+	_globalData.lights.clear();
+	if( _globalData.shader ) delete _globalData.shader , _globalData.shader = NULL;
+	_localData.textures.clear();
+	_localData.materials.clear();
+	_localData.files.clear();
+	_localData.vertices.clear();
+	if( _localData.keyFrameFile ) delete _localData.keyFrameFile , _localData.keyFrameFile = NULL;
+	_shapeList.shapes.clear();
+	// The lights and shapes were constructed in the scene's factory storage
+	_factoryStorage.clear();
+}
+
 void Scene::drawOpenGL( void ) const
 {
 	_globalData.camera.drawOpenGL();
@@ -517,46 +1072,434 @@ void Scene::drawOpenGL( void ) const
 	ASSERT_OPEN_GL_STATE();	
 }
 
+/** This function converts the (scaled) colors to an image, clamping to the range of the pixels. */
+static Image32 ToImage( int width , int height , const std::vector< Point3D > &colors , double scale )
+{
+	Image32 img;
+	img.setSize( width , height );
+	for( unsigned int j=0 ; j<(unsigned int)height ; j++ ) for( unsigned int i=0 ; i<(unsigned int)width ; i++ )
+	{
+		Point3D c = colors[ (size_t)j*width+i ] * scale;
+		Pixel32 p;
+		p.r = std::max< int >( std::min< int >( (int)(c[0]*255) , 255 ) , 0 );
+		p.g = std::max< int >( std::min< int >( (int)(c[1]*255) , 255 ) , 0 );
+		p.b = std::max< int >( std::min< int >( (int)(c[2]*255) , 255 ) , 0 );
+		img(i,j) = p;
+	}
+	return img;
+}
+
+/** The header of a checkpoint file, which is followed by the (width x height x 3) single-precision averages of the colors.
+*** The size of the grid of sub-pixels that the passes are drawn from is stored, since passes from different grids cannot be combined. */
+struct CheckpointHeader
+{
+	char magic[8];
+	uint32_t width , height , passes , grid;
+};
+static const char CheckpointMagic[8] = { 'R' , 'A' , 'Y' , 'C' , 'H' , 'K' , '0' , '3' };
+
+void Scene::WriteCheckpoint( const std::string &fileName , int width , int height , unsigned int grid , const std::vector< Point3D > &colors , unsigned int passes )
+{
+	std::string tempFileName = fileName + std::string( ".tmp" );
+	{
+		std::ofstream stream( tempFileName , std::ios::binary );
+		if( !stream ){ WARN( "Failed to open checkpoint file for writing: " , tempFileName ) ; return; }
+		CheckpointHeader header;
+		memcpy( header.magic , CheckpointMagic , sizeof(CheckpointMagic) );
+		header.width = width , header.height = height , header.passes = passes , header.grid = grid;
+		stream.write( (const char *)&header , sizeof(header) );
+		std::vector< float > values( colors.size()*3 );
+		for( size_t i=0 ; i<colors.size() ; i++ ) for( int c=0 ; c<3 ; c++ ) values[3*i+c] = (float)( colors[i][c] / passes );
+		stream.write( (const char *)values.data() , values.size()*sizeof(float) );
+		if( !stream ){ WARN( "Failed to write checkpoint file: " , tempFileName ) ; return; }
+	}
+	if( !MoveReplacing( tempFileName , fileName ) ) WARN( "Failed to replace checkpoint file: " , fileName );
+}
+
+bool Scene::ReadCheckpoint( const std::string &fileName , int width , int height , unsigned int grid , std::vector< Point3D > &colors , unsigned int &passes )
+{
+	std::ifstream stream( fileName , std::ios::binary );
+	if( !stream ) return false;
+	CheckpointHeader header;
+	if( !stream.read( (char *)&header , sizeof(header) ) || memcmp( header.magic , CheckpointMagic , sizeof(CheckpointMagic) ) )
+	{
+		WARN( "Ignoring malformed checkpoint file: " , fileName );
+		return false;
+	}
+	if( header.width!=(uint32_t)width || header.height!=(uint32_t)height )
+	{
+		WARN( "Ignoring checkpoint with mismatched resolution: " , header.width , " x " , header.height );
+		return false;
+	}
+	if( header.grid!=grid )
+	{
+		WARN( "Ignoring checkpoint with mismatched sub-pixel grid: " , header.grid , " x " , header.grid , " != " , grid , " x " , grid );
+		return false;
+	}
+	std::vector< float > values( colors.size()*3 );
+	if( !stream.read( (char *)values.data() , values.size()*sizeof(float) ) )
+	{
+		WARN( "Ignoring truncated checkpoint file: " , fileName );
+		return false;
+	}
+	passes = header.passes;
+	for( size_t i=0 ; i<colors.size() ; i++ ) for( int c=0 ; c<3 ; c++ ) colors[i][c] = values[3*i+c] * (double)passes;
+	return true;
+}
+
 Image32 Scene::rayTrace( int width , int height , int rLimit , double cLimit , unsigned int lightSamples , bool showProgress )
 {
+	// The colors are accumulated at full precision over the passes (so that they can be averaged and refined by adaptive supersampling)
+	std::vector< Point3D > colors( (size_t)width*height );
+	unsigned int passes = std::max< unsigned int >( ProgressivePasses , 1 ) , pass = 0;
+
+	// Each pass traces the rays through a different sub-pixel of an n x n grid (by tracing the rays for an image with n times the resolution).
+	// The sub-pixels are visited in the order in which the points of the (0,2)-sequence first fall into them, so that the first passes are spread over the pixel.
+	// (Once the sequence has been snapped to a grid at least twice as fine, every sub-pixel contains one of its points.)
+	unsigned int n = 1 , subI = 0 , subJ = 0;
+	while( n*n<passes ) n++;
+	std::vector< unsigned int > subPixels;
+	{
+		std::vector< bool > visited( n*n , false );
+		unsigned int fine = 1;
+		while( fine<2*n ) fine *= 2;
+		for( uint32_t s=0 ; s<fine*fine && subPixels.size()<n*n ; s++ )
+		{
+			Point2D sub = Sampler::Sobol( s , 0 , 0 );
+			unsigned int subPixel = std::min< unsigned int >( (unsigned int)( sub[1]*n ) , n-1 ) * n + std::min< unsigned int >( (unsigned int)( sub[0]*n ) , n-1 );
+			if( !visited[subPixel] ) visited[subPixel] = true , subPixels.push_back( subPixel );
+		}
+	}
+
+	if( passes>1 && CheckpointFile.length() && ReadCheckpoint( CheckpointFile , width , height , n , colors , pass ) )
+	{
+		std::cout << "Resuming from pass " << pass << " / " << passes << std::endl;
+		// If the checkpoint holds more passes than requested, rescale the accumulated colors so that they are normalized by the requested number
+		if( pass>passes )
+		{
+			for( size_t i=0 ; i<colors.size() ; i++ ) colors[i] *= (double)passes / pass;
+			pass = passes;
+		}
+	}
+
 	Util::ProgressBar *progressBar = NULL;
-	if( showProgress ) progressBar = new Util::ProgressBar( 20 , (size_t)(width*height) , "Ray Tracing" );
+	if( showProgress ) progressBar = new Util::ProgressBar( 20 , (size_t)width*height*(passes-pass) , "Ray Tracing" );
 
 	updateBoundingBox();
-	Image32 img;
+	_updateInstanceBVH();
+
+	auto PrimaryRay = [&]( unsigned int i , unsigned int j ){ return _globalData.camera.getRay( i*n+subI , (height-j-1)*n+(n-1-subJ) , width*n , height*n ); };
+	// The differentials are only used to filter textures, so the rays through the neighboring pixels are not traced if there are none
+	bool textured = hasTextures();
+	auto PrimaryRayDifferential = [&]( unsigned int i , unsigned int j ){ return textured ? _globalData.camera.getRayDifferential( i*n+subI , (height-j-1)*n+(n-1-subJ) , width*n , height*n ) : RayDifferential(); };
 
-	img.setSize( width , height );
 	auto RayTraceFunction = [&]( unsigned int threadIndex , size_t pixelIndex )
 	{
 		unsigned int i = (unsigned int)(pixelIndex%width) , j = (unsigned int)(pixelIndex/width);
 		if( showProgress ) progressBar->update( threadIndex==0 );
+		Sampler::Get( threadIndex ).setPixel( i , j , pass );
 		try
 		{
-			Ray3D ray = _globalData.camera.getRay( i , height-j-1 , width , height );
-			Point3D c = getColor( ray , rLimit , Point3D( cLimit , cLimit , cLimit ) , lightSamples , threadIndex );
-			Pixel32 p;
-			p.r = std::max< int >( std::min< int >( (int)(c[0]*255) , 255 ) , 0 );
-			p.g = std::max< int >( std::min< int >( (int)(c[1]*255) , 255 ) , 0 );
-			p.b = std::max< int >( std::min< int >( (int)(c[2]*255) , 255 ) , 0 );
-			img(i,j) = p;
+			Ray3D ray = PrimaryRay( i , j );
+			colors[pixelIndex] += getColor( ray , PrimaryRayDifferential( i , j ) , rLimit , Point3D( cLimit , cLimit , cLimit ) , lightSamples , threadIndex );
 		}
 		catch( std::exception &e ){ ERROR_OUT( "failed to generate pixel ( " , i , " , " , j , " ) " , e.what() ); }
 	};
-#if 1
-	for( size_t idx=0 ; idx<(size_t)(width*height) ; idx++ ) RayTraceFunction( 0 , idx );
-#else
-	ThreadPool::Parallel_for( 0 , (size_t)(width*height) , RayTraceFunction );
-#endif
+
+	// Split the image into tiles and order them along a Morton curve so that consecutive tiles are spatially coherent
+	unsigned int tileSize = std::max< unsigned int >( TileSize , 1 );
+	unsigned int tilesX = ( width + tileSize - 1 ) / tileSize , tilesY = ( height + tileSize - 1 ) / tileSize;
+	std::vector< std::pair< unsigned long long , unsigned int > > tiles( tilesX*tilesY );
+	for( unsigned int j=0 ; j<tilesY ; j++ ) for( unsigned int i=0 ; i<tilesX ; i++ ) tiles[ j*tilesX+i ] = std::make_pair( MortonCode( i , j ) , j*tilesX+i );
+	std::sort( tiles.begin() , tiles.end() );
+
+	// The dimensions of the block of pixels whose primary rays are traced together as a packet
+	unsigned int packetWidth = 1 , packetHeight = 1;
+	switch( PacketSize )
+	{
+		case  1: break;
+		case  4: packetWidth = packetHeight = 2 ; break;
+		case  8: packetWidth = 4 , packetHeight = 2 ; break;
+		case 16: packetWidth = packetHeight = 4 ; break;
+		default: WARN( "unsupported packet size, tracing primary rays individually: " , PacketSize );
+	}
+	_primaryHits.assign( ThreadPool::NumThreads() , NULL );
+	if( _scratchArenas.size()<ThreadPool::NumThreads() ) _scratchArenas.resize( ThreadPool::NumThreads() );
+	ScratchArena::Binding scratchArenaBinding( _scratchArenas );
+	Sampler::Reserve( ThreadPool::NumThreads() );
+	RayTracingStats::Reserve( ThreadPool::NumThreads() );
+
+	// Trace the packet of primary rays through the block of pixels, then ray-trace the pixels, reusing the first intersections
+	auto RayTracePacketFunction = [&]( unsigned int threadIndex , unsigned int i0 , unsigned int iEnd , unsigned int j0 , unsigned int jEnd )
+	{
+		RayPacket packet;
+		size_t pixelIndices[ RayPacket::MaxSize ];
+		_PrimaryHit hits[ RayPacket::MaxSize ];
+
+		packet.size = 0;
+		for( unsigned int j=j0 ; j<jEnd ; j++ ) for( unsigned int i=i0 ; i<iEnd ; i++ )
+		{
+			pixelIndices[ packet.size ] = (size_t)j*width + i;
+			packet.rays[ packet.size ] = PrimaryRay( i , j );
+			packet.ranges[ packet.size ] = BoundingBox1D( Point1D( 0. ) , Point1D( Infinity ) );
+			hits[ packet.size ].valid = true;
+			hits[ packet.size ].ray = packet.rays[ packet.size ];
+			packet.size++;
+		}
+		packet.mask = ( 1u<<packet.size ) - 1;
+
+		try
+		{
+			processFirstIntersections( packet , [&]( unsigned int k , const ShapeProcessingInfo &spInfo , const RayShapeIntersectionInfo &iInfo )
+			{
+				hits[k].hit = true , hits[k].spInfo = spInfo , hits[k].iInfo = iInfo;
+			}
+			, ShapeProcessingInfo() , threadIndex );
+		}
+		catch( std::exception &e )
+		{
+			WARN_ONCE( "failed to trace packet: " , e.what() );
+			for( unsigned int k=0 ; k<packet.size ; k++ ) hits[k].valid = false;
+		}
+
+		for( unsigned int k=0 ; k<packet.size ; k++ )
+		{
+			_primaryHits[ threadIndex ] = &hits[k];
+			RayTraceFunction( threadIndex , pixelIndices[k] );
+			_primaryHits[ threadIndex ] = NULL;
+		}
+	};
+
+	for( ; pass<passes ; pass++ )
+	{
+		subI = subPixels[pass] % n , subJ = subPixels[pass] / n;
+
+		// Tiles vary in cost, so they are handed out to the threads one at a time
+		ThreadPool::Parallel_for( 0 , tiles.size() , [&]( unsigned int threadIndex , size_t t )
+		{
+			unsigned int tx = tiles[t].second % tilesX , ty = tiles[t].second / tilesX;
+			unsigned int iEnd = std::min< unsigned int >( (tx+1)*tileSize , width ) , jEnd = std::min< unsigned int >( (ty+1)*tileSize , height );
+			if( packetWidth*packetHeight==1 ) for( unsigned int j=ty*tileSize ; j<jEnd ; j++ ) for( unsigned int i=tx*tileSize ; i<iEnd ; i++ ) RayTraceFunction( threadIndex , (size_t)j*width + i );
+			else
+				for( unsigned int j=ty*tileSize ; j<jEnd ; j+=packetHeight ) for( unsigned int i=tx*tileSize ; i<iEnd ; i+=packetWidth )
+					RayTracePacketFunction( threadIndex , i , std::min< unsigned int >( i+packetWidth , iEnd ) , j , std::min< unsigned int >( j+packetHeight , jEnd ) );
+		}
+		, ThreadPool::DYNAMIC , 1 );
+
+		// Write out the preview and the checkpoint (so that the render can be resumed if it is stopped)
+		if( passes>1 )
+		{
+			if( PreviewFile.length() ) ToImage( width , height , colors , 1./(pass+1) ).write( PreviewFile );
+			if( CheckpointFile.length() ) WriteCheckpoint( CheckpointFile , width , height , n , colors , pass+1 );
+		}
+	}
+	_primaryHits.clear();
+
+	if( passes>1 ) for( size_t i=0 ; i<colors.size() ; i++ ) colors[i] /= passes;
+	if( PixelSamples>1 ) _supersample( width , height , rLimit , cLimit , lightSamples , colors );
 
 	if( showProgress ) delete progressBar;
-	return img;
+	return ToImage( width , height , colors , 1. );
+}
+
+void Scene::_supersample( int width , int height , int rLimit , double cLimit , unsigned int lightSamples , std::vector< Point3D > &colors )
+{
+	// Mark the pixels that differ from one of their neighbors by more than the threshold (in some channel)
+	auto Differ = [&]( size_t p1 , size_t p2 )
+	{
+		for( int c=0 ; c<3 ; c++ ) if( fabs( colors[p1][c]-colors[p2][c] )>PixelSampleThreshold ) return true;
+		return false;
+	};
+	auto DiffersFromNeighbor = [&]( size_t p )
+	{
+		unsigned int i = (unsigned int)(p%width) , j = (unsigned int)(p/width);
+		return ( i>0 && Differ( p , p-1 ) ) || ( i+1<(unsigned int)width && Differ( p , p+1 ) ) || ( j>0 && Differ( p , p-width ) ) || ( j+1<(unsigned int)height && Differ( p , p+width ) );
+	};
+	std::vector< size_t > refine;
+	for( size_t p=0 ; p<colors.size() ; p++ ) if( DiffersFromNeighbor( p ) ) refine.push_back( p );
+	if( refine.empty() ) return;
+	bool textured = hasTextures();
+
+	// The sub-pixel positions are the points of the (0,2)-sequence, snapped to a grid of resolution x resolution cells (by tracing the rays for an image with resolution times the resolution),
+	// so that the first 2^k samples of any pixel are stratified and any number of samples can be traced
+	unsigned int resolution = 16 , passes = std::max< unsigned int >( ProgressivePasses , 1 );
+	while( resolution*resolution<PixelSamples ) resolution *= 2;
+
+	// With a single pass, the initial color is the sample through the pixel's center, and the samples are reconstructed with a tent filter centered on the pixel.
+	// With progressive passes, the initial color is already the average of passes samples spread over the pixel, so it is weighted by the number of passes
+	// and the samples are reconstructed with a box filter.
+	std::vector< Point3D > sums( refine.size() );
+	std::vector< double > weightSums( refine.size() , (double)passes );
+	for( size_t r=0 ; r<refine.size() ; r++ ) sums[r] = colors[ refine[r] ] * passes;
+
+	// Each round doubles the number of samples through the pixels that still differ from one of their neighbors, so that the pixels whose colors converge stop early
+	std::vector< size_t > active( refine.size() );
+	for( size_t r=0 ; r<refine.size() ; r++ ) active[r] = r;
+	for( unsigned int samples=0 , roundSamples=std::min< unsigned int >( 2 , PixelSamples ) ; samples<PixelSamples && active.size() ; samples+=roundSamples , roundSamples=std::min< unsigned int >( samples , PixelSamples-samples ) )
+	{
+		ThreadPool::Parallel_for( 0 , active.size() , [&]( unsigned int threadIndex , size_t a )
+		{
+			size_t r = active[a];
+			unsigned int i = (unsigned int)(refine[r]%width) , j = (unsigned int)(refine[r]/width);
+			try
+			{
+				for( unsigned int s=samples ; s<samples+roundSamples ; s++ )
+				{
+					Point2D sub = Sampler::Sobol( s , 0 , 0 );
+					unsigned int si = std::min< unsigned int >( (unsigned int)( sub[0]*resolution ) , resolution-1 ) , sj = std::min< unsigned int >( (unsigned int)( sub[1]*resolution ) , resolution-1 );
+					// The sample indices continue past those of the progressive passes, so that the light samples are not correlated with theirs
+					Sampler::Get( threadIndex ).setPixel( i , j , passes+s );
+					int x = i*resolution+si , y = (height-j-1)*resolution+(resolution-1-sj);
+					Ray3D ray = _globalData.camera.getRay( x , y , width*resolution , height*resolution );
+					RayDifferential rDifferential = textured ? _globalData.camera.getRayDifferential( x , y , width*resolution , height*resolution ) : RayDifferential();
+					double dx = ( si+0.5 )/resolution - 0.5 , dy = ( sj+0.5 )/resolution - 0.5;
+					double weight = passes>1 ? 1. : ( 1.-fabs(dx) ) * ( 1.-fabs(dy) );
+					sums[r] += getColor( ray , rDifferential , rLimit , Point3D( cLimit , cLimit , cLimit ) , lightSamples , threadIndex ) * weight;
+					weightSums[r] += weight;
+				}
+			}
+			catch( std::exception &e ){ ERROR_OUT( "failed to supersample pixel ( " , i , " , " , j , " ) " , e.what() ); }
+		}
+		, ThreadPool::DYNAMIC , 16 );
+
+		// Update the colors once the round is done (so that the differences are computed from the colors at the end of the previous round)
+		// and keep refining the pixels that still differ from one of their neighbors
+		for( size_t a=0 ; a<active.size() ; a++ ) colors[ refine[ active[a] ] ] = sums[ active[a] ] / weightSums[ active[a] ];
+		size_t activeNum = 0;
+		for( size_t a=0 ; a<active.size() ; a++ ) if( DiffersFromNeighbor( refine[ active[a] ] ) ) active[ activeNum++ ] = active[a];
+		active.resize( activeNum );
+	}
+}
+
+bool Scene::_PrimaryHit::matches( const Ray3D &ray ) const
+{
+	if( !valid ) return false;
+	for( int d=0 ; d<3 ; d++ ) if( this->ray.position[d]!=ray.position[d] || this->ray.direction[d]!=ray.direction[d] ) return false;
+	return true;
 }
 
 bool Scene::processFirstIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
+	// If this is the primary ray of the pixel being traced and its first intersection (within [0,infinity)) was computed as part of a packet, try to reuse the intersection
+	if( tIdx<_primaryHits.size() && _primaryHits[tIdx] && _primaryHits[tIdx]->matches( ray ) && range[0][0]>=0 )
+	{
+		const _PrimaryHit &pHit = *_primaryHits[tIdx];
+		if( !pHit.hit || pHit.iInfo.t>range[1][0] ) return false;
+		// Otherwise the intersection can only be reused if it is in range and passes the filter
+		if( pHit.iInfo.t>=range[0][0] && rFilter( pHit.iInfo.t ) ){ rKernel( pHit.spInfo , pHit.iInfo ) ; return true; }
+	}
+
+	if( !_instanceBVH.empty() ) return _processFirstIntersectionInstances( ray , range , rFilter , rKernel , tIdx );
 	return SceneGeometry::processFirstIntersection( ray , range , rFilter , rKernel , spInfo , tIdx );
 }
 
+void Scene::processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	if( _instanceBVH.empty() ) return SceneGeometry::processFirstIntersections( packet , rpKernel , spInfo , tIdx );
+
+	// The rays are taken into the frames of the instances in a single local packet, copying only the active rays in and their ranges back out
+	RayPacket _packet;
+	_packet.size = packet.size;
+	_instanceBVH.traverse( packet , [&]( unsigned int begin , unsigned int end , unsigned int mask )
+	{
+		_packet.mask = mask;
+		for( unsigned int i=begin ; i<end ; i++ )
+		{
+			const _Instance &instance = _instances[ _instanceBVH.index(i) ];
+			for( unsigned int j=0 ; j<packet.size ; j++ ) if( mask & (1<<j) ) _packet.rays[j] = instance.spInfo.globalToLocal * packet.rays[j] , _packet.ranges[j] = packet.ranges[j];
+			instance.shape->processFirstIntersections( _packet , rpKernel , instance.spInfo , tIdx );
+			for( unsigned int j=0 ; j<packet.size ; j++ ) if( mask & (1<<j) ) packet.ranges[j] = _packet.ranges[j];
+		}
+	} , tIdx );
+}
+
+bool Scene::processAnyIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	if( _instanceBVH.empty() ) return SceneGeometry::processAnyIntersection( ray , range , rFilter , roKernel , spInfo , tIdx );
+
+	BoundingBox1D _range = range;
+	return _instanceBVH.traverse( ray , _range , [&]( unsigned int begin , unsigned int end )
+	{
+		for( unsigned int i=begin ; i<end ; i++ )
+		{
+			const _Instance &instance = _instances[ _instanceBVH.index(i) ];
+			if( instance.shape->processAnyIntersection( instance.spInfo.globalToLocal * ray , range , rFilter , roKernel , instance.spInfo , tIdx ) ) return true;
+		}
+		return false;
+	} , tIdx );
+}
+
+void Scene::_updateInstanceBVH( void )
+{
+	_instances.clear();
+	_instanceBVH.clear();
+	if( !ShapeList::UseBVH ) return;
+
+	// Gather the root lists of the (nested) .ray files. A file instance forwards the traversal to its file, so the walk reaches these lists,
+	// and their hierarchies are shared by every instance of the file.
+	std::unordered_set< const Shape * > fileRoots;
+	std::vector< const SceneGeometry * > geometries( 1 , this );
+	while( geometries.size() )
+	{
+		const SceneGeometry *geometry = geometries.back();
+		geometries.pop_back();
+		for( unsigned int i=0 ; i<geometry->_localData.files.size() ; i++ )
+		{
+			fileRoots.insert( &geometry->_localData.files[i]._shapeList );
+			geometries.push_back( &geometry->_localData.files[i] );
+		}
+	}
+
+	// Descend through the lists and affine shapes, accumulating their transformations,
+	// and stop at the shapes that have hierarchies of their own (the root lists of files and triangle lists) and at the primitives
+	Filter filter = [&]( const ShapeProcessingInfo & , const Shape &shape )
+	{
+		if( dynamic_cast< const TriangleList * >( &shape ) || fileRoots.count( &shape ) ) return ShapeProcessingInfo::TERMINATE;
+		else if( dynamic_cast< const ShapeList * >( &shape ) || dynamic_cast< const AffineShape * >( &shape ) ) return ShapeProcessingInfo::PROPAGATE;
+		else return ShapeProcessingInfo::TERMINATE;
+	};
+	Kernel kernel = [&]( const ShapeProcessingInfo &spInfo , const Shape &shape ){ _instances.push_back( { &shape , spInfo } ); };
+	SceneGeometry::processOverlapping( filter , kernel , ShapeProcessingInfo() );
+
+	std::vector< BoundingBox3D > bBoxes( _instances.size() );
+	for( unsigned int i=0 ; i<_instances.size() ; i++ ) bBoxes[i] = _instances[i].spInfo.localToGlobal * _instances[i].shape->boundingBox();
+	_instanceBVH.set( bBoxes );
+}
+
+bool Scene::_processFirstIntersectionInstances( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , unsigned int tIdx ) const
+{
+	BoundingBox1D _range = range;
+	ShapeProcessingInfo hitSPInfo;
+	RayShapeIntersectionInfo hitIInfo;
+	bool hit = false;
+
+	// Record the closest intersection, shrinking the range so that farther instances are culled
+	auto kernel = [&]( const ShapeProcessingInfo &_spInfo , const RayShapeIntersectionInfo &_iInfo )
+	{
+		if( _iInfo.t<hitIInfo.t )
+		{
+			hitSPInfo = _spInfo , hitIInfo = _iInfo;
+			_range[1][0] = _iInfo.t;
+			hit = true;
+		}
+		return true;
+	};
+
+	// The instances' transformations are precomputed, so a single matrix-ray product takes the ray into the frame of an instance
+	_instanceBVH.traverse( ray , _range , [&]( unsigned int begin , unsigned int end )
+	{
+		for( unsigned int i=begin ; i<end ; i++ )
+		{
+			const _Instance &instance = _instances[ _instanceBVH.index(i) ];
+			instance.shape->processFirstIntersection( instance.spInfo.globalToLocal * ray , _range , rFilter , kernel , instance.spInfo , tIdx );
+		}
+		return false;
+	} , tIdx );
+
+	if( hit ) rKernel( hitSPInfo , hitIInfo );
+	return hit;
+}
+
 int Scene::processAllIntersections( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
 	return SceneGeometry::processAllIntersections( ray , range , rFilter , rKernel , spInfo , tIdx );
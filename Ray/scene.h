@@ -9,6 +9,8 @@
 #include "shapeList.h"
 #include "keyFrames.h"
 #include "camera.h"
+#include "sampler.h"
+#include "rayDifferential.h"
 
 namespace Ray
 {
@@ -47,6 +49,12 @@ namespace Ray
 		/** The destructor */
 		~GlobalSceneData( void );
 
+		/** This method writes the global data out to a stream in the binary format of the scene cache */
+		void writeBinary( std::ostream &stream ) const;
+
+		/** This method reads the global data in from a stream in the binary format of the scene cache */
+		void readBinary( std::istream &stream );
+
 		/** The set of light factories */
 		static std::unordered_map< std::string , Util::BaseFactory< Light > * > LightFactories;
 	};
@@ -88,6 +96,13 @@ namespace Ray
 
 		/** The destructor */
 		~LocalSceneData( void );
+
+		/** This method writes the local data out to a stream in the binary format of the scene cache.
+		*** Nested .ray files and key-frames are written in full, while textures are written by name (and read from the image files). */
+		void writeBinary( std::ostream &stream ) const;
+
+		/** This method reads the local data in from a stream in the binary format of the scene cache */
+		void readBinary( std::istream &stream );
 	};
 
 	/** An operator for inserting the local data into a stream */
@@ -96,9 +111,40 @@ namespace Ray
 	/** An operator for extracting the local data from a stream */
 	std::istream &operator >> ( std::istream &stream ,       LocalSceneData &data );
 
+	/** If a ray intersects a shape, the shape information at the point of intersection is stored in this class. */
+	class RayShapeIntersectionInfo
+	{
+	public:
+		/** The default constructor (setting the time to intersection at Infinity) */
+		RayShapeIntersectionInfo( void );
+
+		/** The time to intersection */
+		double t;
+
+		/** The position, in world coordinates, of the intersection */
+		Util::Point3D position;
+
+		/** The normal of the shape at the point of intersection */
+		Util::Point3D normal;
+
+		/** The texture coordinates of the the shape at the point of intersection */
+		Util::Point2D texture;
+
+		/** The gradients (in world coordinates) of the two texture coordinates at the point of intersection, or zero if the shape does not provide them */
+		Util::Point3D textureGradients[2];
+
+		/** Checks if the time to intersection of the first object is before the time to intersection of the second */
+		bool operator < ( const RayShapeIntersectionInfo &iInfo ) const;
+
+		/** Checks if the time to intersection of the first object is before the prescribed */
+		bool operator < ( double t ) const;
+	};
+
 	/** This class stores all of the information describing the geometry in a scene */
 	class SceneGeometry : public Shape
 	{
+		friend class Scene;
+
 		/** The local data */
 		LocalSceneData _localData;
 
@@ -116,6 +162,18 @@ namespace Ray
 		/** This method updates the current time, changing the parameter values as needed */
 		void setCurrentTime( double t , int curveFit );
 
+		/** This method writes the local data and the scene-graph out to a stream in the binary format of the scene cache */
+		void writeBinary( std::ostream &stream ) const;
+
+		/** This method reads the local data and the scene-graph in from a stream in the binary format of the scene cache */
+		void readBinary( std::istream &stream );
+
+		/** This method appends the names of the files that the geometry was read from (the nested .ray files and the key-frame files) */
+		void dependencies( std::vector< std::string > &fileNames ) const;
+
+		/** This method returns true if the geometry, or any of the nested .ray files, has a texture */
+		bool hasTextures( void ) const;
+
 		///////////////////
 		// Shape methods //
 		///////////////////
@@ -129,6 +187,8 @@ namespace Ray
 		void updateBoundingBox( void );
 		bool processFirstIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 		int processAllIntersections( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		void processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		bool processAnyIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 		void processOverlapping( const Filter &filter , const Kernel &kernel , ShapeProcessingInfo tInfo ) const;
 		bool isInside( Util::Point3D p ) const;
 		void drawOpenGL( GLSLProgram *glslProgram ) const;
@@ -142,13 +202,104 @@ namespace Ray
 		friend std::ostream &operator << ( std::ostream & , const Scene & );
 		friend std::istream &operator >> ( std::istream & ,       Scene & );
 
+		/** The storage owning the lights and shapes created by the factories while the scene is read, which are destroyed (and freed all at once) with the scene */
+		Util::FactoryStorage _factoryStorage;
+
 		/** The global data */
 		GlobalSceneData _globalData;
 
+		/** This class stores the first intersection of a primary ray within [0,infinity), computed as part of a packet, so that it can be reused when the ray is traced */
+		struct _PrimaryHit
+		{
+			bool valid , hit;
+			Util::Ray3D ray;
+			ShapeProcessingInfo spInfo;
+			RayShapeIntersectionInfo iInfo;
+			_PrimaryHit( void ) : valid(false) , hit(false) {}
+
+			/** This method returns true if the hit is valid and was computed for the prescribed ray. */
+			bool matches( const Util::Ray3D &ray ) const;
+		};
+
+		/** For each thread, the primary hit of the pixel whose color the thread is computing (or NULL if there is none).
+		*** The pointer is only set for the duration of the computation of the pixel's color, and the hit is only used for queries along the same ray. */
+		std::vector< const _PrimaryHit * > _primaryHits;
+
+		/** The scratch memory of the threads, which is bound while the scene is ray-traced (and is retained across renderings, so that the threads do not allocate once they are warmed up) */
+		std::vector< ScratchArena > _scratchArenas;
+
+		/** This class represents an instance in the top level of the two-level hierarchy: a shape (whose own hierarchy forms the bottom level)
+		*** together with the accumulated transformations of the scene-graph nodes above it */
+		struct _Instance
+		{
+			const Shape *shape;
+			ShapeProcessingInfo spInfo;
+		};
+
+		/** The instances in the top level of the two-level hierarchy */
+		std::vector< _Instance > _instances;
+
+		/** The top level of the two-level hierarchy, over the instances' world-space bounding boxes (empty if it has not been built) */
+		BVH _instanceBVH;
+
+		/** This method flattens the scene-graph into instances and (re)builds the top level of the two-level hierarchy, if requested. */
+		void _updateInstanceBVH( void );
+
+		/** This method supersamples the pixels whose colors differ from one of their neighbors' by more than PixelSampleThreshold, tracing up to PixelSamples rays
+		*** through stratified sub-pixel positions and reconstructing the colors with a tent filter. The samples are traced in rounds that double their number,
+		*** and a pixel stops being refined once its color no longer differs from its neighbors'. */
+		void _supersample( int width , int height , int rLimit , double cLimit , unsigned int lightSamples , std::vector< Util::Point3D > &colors );
+
+		/** This method writes the scene out to the binary cache, together with the state of the files it was read from. */
+		void _writeCache( const std::string &cacheFileName , const std::string &fileName ) const;
+
+		/** This method reads the scene in from the binary cache, returning false (and leaving the scene empty) if there is no cache, if the cache is of a different version or is unreadable, or if any of the files the scene was read from has changed. */
+		bool _readCache( const std::string &cacheFileName );
+
+		/** This method discards the contents of the scene (e.g. those read from a cache that turned out to be unreadable), leaving it as it was before it was read. */
+		void _clear( void );
+
+		/** This method processes the first intersection by traversing the top level of the two-level hierarchy and transforming the ray into the frames of the instances. */
+		bool _processFirstIntersectionInstances( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , unsigned int tIdx ) const;
+
 	public:
 		/** The base directory */
 		static std::string BaseDir;
 
+		/** The width/height (in pixels) of the square tiles into which the image is split for (parallel) ray-tracing */
+		static unsigned int TileSize;
+
+		/** The number of primary rays traced together as a packet (4, 8, or 16), or one if primary rays should be traced individually */
+		static unsigned int PacketSize;
+
+		/** The maximum number of rays traced through a pixel that is adaptively supersampled (or one if adaptive supersampling is disabled) */
+		static unsigned int PixelSamples;
+
+		/** The difference in (some channel of) the color of neighboring pixels beyond which they are supersampled */
+		static double PixelSampleThreshold;
+
+		/** The number of passes of progressive rendering, each tracing one ray through every pixel (or one if rendering should not be progressive) */
+		static unsigned int ProgressivePasses;
+
+		/** The file to which the accumulated colors are written after every progressive pass, and from which an interrupted render is resumed (if non-empty) */
+		static std::string CheckpointFile;
+
+		/** The file to which a preview image is written after every progressive pass (if non-empty) */
+		static std::string PreviewFile;
+
+		/** A global variable indicating if scenes should be read through a binary cache, stored alongside the .ray file and regenerated when the files the scene was read from change */
+		static bool UseCache;
+
+		/** This method writes out the accumulated colors (normalized by the number of passes), first to a temporary file which then replaces the checkpoint (so that a checkpoint is never left partially written).
+		*** The size of the grid of sub-pixels that the passes are drawn from is stored, since passes from different grids cannot be combined. */
+		static void WriteCheckpoint( const std::string &fileName , int width , int height , unsigned int grid , const std::vector< Util::Point3D > &colors , unsigned int passes );
+
+		/** This method reads in the accumulated colors and the number of passes from the checkpoint, returning false if there is no (matching) checkpoint. */
+		static bool ReadCheckpoint( const std::string &fileName , int width , int height , unsigned int grid , std::vector< Util::Point3D > &colors , unsigned int &passes );
+
+		/** This method reads the scene in from the .ray file (through the binary cache, if requested) and initializes it */
+		void read( const std::string &fileName );
+
 		/** This function reflects the vector v about the normal n. */
 		static Util::Point3D Reflect( Util::Point3D v , Util::Point3D n );
 
@@ -158,8 +309,9 @@ namespace Ray
 
 		/** This is the function responsible for the recursive ray-tracing returning the color obtained
 		*** by shooting a ray into the scene and recursing until either the recursion depth has been reached
-		*** or the contribution from subsequent bounces is guaranteed to be less than the cut-off. */
-		Util::Point3D getColor( Util::Ray3D ray , int rDepth , Util::Point3D cLimit , unsigned int lightSamples , unsigned int tIdx );
+		*** or the contribution from subsequent bounces is guaranteed to be less than the cut-off.
+		*** The differentials of the ray are used to choose the level at which textures are sampled, and should be propagated to reflected and refracted rays. */
+		Util::Point3D getColor( Util::Ray3D ray , const RayDifferential &rDifferential , int rDepth , Util::Point3D cLimit , unsigned int lightSamples , unsigned int tIdx );
 
 		/** This method ray-traces the scene and returns the computed image */
 		Image::Image32 rayTrace( int width , int height , int rLimit , double cLimit , unsigned int lightSamples , bool showProgress );
@@ -173,6 +325,8 @@ namespace Ray
 		/** This method ray-traces the primitive */
 		bool processFirstIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 		int processAllIntersections( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		void processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		bool processAnyIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 	};
 
 	/** This operator writes a Scene object out to a stream. */
@@ -218,32 +372,6 @@ namespace Ray
 	/** This operator reads in a Vertex object from a stream. */
 	std::istream &operator >> ( std::istream &stream ,       Vertex &vertex );
 
-	/** If a ray intersects a shape, the shape information at the point of intersection is stored in this class. */
-	class RayShapeIntersectionInfo
-	{
-	public:
-		/** The default constructor (setting the time to intersection at Infinity) */
-		RayShapeIntersectionInfo( void );
-
-		/** The time to intersection */
-		double t;
-
-		/** The position, in world coordinates, of the intersection */
-		Util::Point3D position;
-
-		/** The normal of the shape at the point of intersection */
-		Util::Point3D normal;
-
-		/** The texture coordinates of the the shape at the point of intersection */
-		Util::Point2D texture;
-
-		/** Checks if the time to intersection of the first object is before the time to intersection of the second */
-		bool operator < ( const RayShapeIntersectionInfo &iInfo ) const;
-
-		/** Checks if the time to intersection of the first object is before the prescribed */
-		bool operator < ( double t ) const;
-	};
-
 	/** This class stores surface material properties. */
 	class Material
 	{
@@ -308,12 +436,33 @@ namespace Ray
 		/** The name of the texture file */
 		std::string _filename;
 
-		/** The image used as a texture */
+		/** The image used as a texture, stored in row-major order (so that its pixels can be accessed directly, e.g. when the texture is set up for OpenGL) */
 		Image::Image32 _image;
 
+		/** A copy of the image stored in tiles, from which the texture is sampled */
+		Image::Image32 _samplingImage;
+
+		/** The successively down-sampled (by factors of two) copies of the image, generated (and stored in tiles) when the texture is read */
+		std::vector< Image::Image32 > _mipMaps;
+
 		/** The texture handle for OpenGL rendering */
 		GLuint _openGLHandle;
+
+		/** This method generates the mip-maps from the image */
+		void _setMipMaps( void );
+
+		/** This method returns the bilinearly interpolated value of the prescribed level of the mip-map pyramid (with level zero the tiled copy of the image) */
+		Util::Point3D _sample( unsigned int level , Util::Point2D texture ) const;
 	public:
+		/** This method returns the color of the texture (with values in the range [0,1]) at the prescribed texture coordinates.
+		*** The coordinates wrap around, with (0,0) at the first pixel of the image and the second coordinate increasing with the row.
+		*** The width of the footprint (in texture coordinates) determines the level of the mip-map pyramid that is sampled,
+		*** with the sample trilinearly interpolated between the two nearest levels. */
+		Util::Point3D sample( Util::Point2D texture , double width ) const;
+
+		/** This method returns the color of the texture at the point of intersection, using the differentials of the ray (transferred to the point of intersection) to get the width of the footprint. */
+		Util::Point3D sample( const RayShapeIntersectionInfo &iInfo , const RayDifferential &rDifferential ) const;
+
 		/** This method sets up the OpenGL texture */
 		void initOpenGL( void );
 	};
@@ -359,6 +508,26 @@ namespace Ray
 
 		/** The key-frame data associated with a .key file */
 		KeyFrameMatrices keyFrameMatrices;
+
+		/** This method sets the current transformations using the prescribed (normalized) time and updates their inverse and normal transformations */
+		void setCurrentValues( double t , int curveType );
+
+		/** This method recomputes the inverse and normal transformations from the current transformations.
+		*** (A singular transformation is assigned zero inverse and normal transformations.) */
+		void updateCurrentInverses( void );
+
+		/** This method returns a reference to the inverse of the current transformation for the specified dof */
+		const Util::Matrix4D &currentInverse( const std::string &dofName ) const;
+
+		/** This method returns a reference to the normal transformation (the inverse transpose) of the current transformation for the specified dof */
+		const Util::Matrix3D &currentNormal( const std::string &dofName ) const;
+
+	protected:
+		/** The inverses of the current transformations */
+		std::vector< Util::Matrix4D > _currentInverses;
+
+		/** The normal transformations of the current transformations */
+		std::vector< Util::Matrix3D > _currentNormals;
 	};
 
 	/** This operator writes out a KeyFrameFile object to a stream. */
@@ -26,13 +26,13 @@ bool Scene::Refract( Point3D v , Point3D n , double ir , Point3D& refract )
 	return false;
 }
 
-Point3D Scene::getColor( Ray3D ray , int rDepth , Point3D cLimit , unsigned int lightSamples , unsigned int tIdx )
+Point3D Scene::getColor( Ray3D ray , const RayDifferential &rDifferential , int rDepth , Point3D cLimit , unsigned int lightSamples , unsigned int tIdx )
 {
 	Point3D color;
-	RayTracingStats::IncrementRayNum();
+	RayTracingStats::IncrementRayNum( tIdx );
 	ShapeProcessingInfo spInfo;
-	RayIntersectionFilter rFilter = []( double ){ return true; };
-	RayIntersectionKernel rKernel = [&]( const ShapeProcessingInfo &spInfo , const RayShapeIntersectionInfo &_iInfo )
+	auto rFilter = []( double ){ return true; };
+	auto rKernel = [&]( const ShapeProcessingInfo &spInfo , const RayShapeIntersectionInfo &_iInfo )
 	{
 		/////////////////////////////////////////////////////////
 		// Create the computational kernel that gets the color //
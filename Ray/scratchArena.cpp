@@ -0,0 +1,8 @@
+#include "scratchArena.h"
+
+using namespace Ray;
+
+//////////////////
+// ScratchArena //
+//////////////////
+std::vector< ScratchArena > *ScratchArena::_Arenas = NULL;
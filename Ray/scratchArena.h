@@ -0,0 +1,77 @@
+#ifndef SCRATCH_ARENA_INCLUDED
+#define SCRATCH_ARENA_INCLUDED
+#include <vector>
+#include <type_traits>
+#include <Util/alignedAllocator.h>
+
+namespace Ray
+{
+	/** This class represents a stack of scratch memory for temporaries (e.g. lists of bounding-box hits and traversal stacks) that are needed while tracing a ray.
+	*** Memory is obtained in blocks that are retained once allocated, so that after a warm-up period tracing a ray performs no heap allocations.
+	*** Memory is released by scope, using the ScratchArena::Scope class.
+	*** There is one arena per thread, accessed through ScratchArena::Get( tIdx ). The arenas are owned by the Scene, which binds them while it is ray-traced. */
+	class ScratchArena
+	{
+	public:
+		/** This class records the state of the arena on construction and releases all the memory allocated from the arena since then on destruction. */
+		class Scope
+		{
+			ScratchArena &_arena;
+			size_t _block , _offset;
+		public:
+			Scope( ScratchArena &arena );
+			~Scope( void );
+			Scope( const Scope & ) = delete;
+			Scope &operator = ( const Scope & ) = delete;
+		};
+
+		/** This class binds the arenas of the threads (indexed by thread) on construction, so that they are returned by ScratchArena::Get, and restores the previous binding on destruction. */
+		class Binding
+		{
+			std::vector< ScratchArena > *_previous;
+		public:
+			Binding( std::vector< ScratchArena > &arenas );
+			~Binding( void );
+			Binding( const Binding & ) = delete;
+			Binding &operator = ( const Binding & ) = delete;
+		};
+
+		/** The size (in bytes) of the first block of memory */
+		static const size_t DefaultBlockSize = 1<<16;
+
+		/** The default constructor */
+		ScratchArena( void );
+
+		/** This method returns (default-initialized) memory for count objects of type T, valid until the enclosing Scope is destroyed.
+		*** Since the objects' destructors are never called, T must be trivially destructible. */
+		template< typename T >
+		T *allocate( size_t count );
+
+		/** This method returns the total size (in bytes) of the blocks allocated by the arena. */
+		size_t capacity( void ) const;
+
+		/** This method returns the number of blocks the arena has allocated from the heap. */
+		size_t blockNum( void ) const;
+
+		/** This static method returns the (bound) arena associated with the thread. */
+		static ScratchArena &Get( unsigned int tIdx );
+
+	protected:
+		/** The blocks of memory */
+		std::vector< Util::AlignedVector< char > > _blocks;
+
+		/** The block from which memory is currently being allocated */
+		size_t _block;
+
+		/** The offset of the first unallocated byte in the current block */
+		size_t _offset;
+
+		/** This method returns size bytes of memory, aligned to the prescribed boundary. */
+		void *_allocate( size_t size , size_t alignment );
+
+		/** The bound arenas, indexed by thread */
+		static std::vector< ScratchArena > *_Arenas;
+	};
+}
+#include "scratchArena.inl"
+#endif // SCRATCH_ARENA_INCLUDED
@@ -0,0 +1,59 @@
+namespace Ray
+{
+	//////////////////
+	// ScratchArena //
+	//////////////////
+	inline ScratchArena::Scope::Scope( ScratchArena &arena ) : _arena(arena) , _block(arena._block) , _offset(arena._offset) {}
+
+	inline ScratchArena::Scope::~Scope( void ){ _arena._block = _block , _arena._offset = _offset; }
+
+	inline ScratchArena::Binding::Binding( std::vector< ScratchArena > &arenas ) : _previous(_Arenas) { _Arenas = &arenas; }
+
+	inline ScratchArena::Binding::~Binding( void ){ _Arenas = _previous; }
+
+	inline ScratchArena::ScratchArena( void ) : _block(0) , _offset(0) {}
+
+	template< typename T >
+	T *ScratchArena::allocate( size_t count )
+	{
+		static_assert( std::is_trivially_destructible< T >::value , "[ERROR] Scratch memory can only hold trivially destructible types" );
+		static_assert( alignof(T)<=Util::CacheLineSize , "[ERROR] Scratch memory is only aligned to cache lines" );
+		T *t = reinterpret_cast< T * >( _allocate( count*sizeof(T) , alignof(T) ) );
+		for( size_t i=0 ; i<count ; i++ ) new( t+i ) T;
+		return t;
+	}
+
+	inline void *ScratchArena::_allocate( size_t size , size_t alignment )
+	{
+		// Look for room in the current block and, failing that, in the blocks that have already been allocated
+		// (Since the blocks start on cache-line boundaries, aligning the offsets aligns the addresses.)
+		for( ; _block<_blocks.size() ; _block++ , _offset=0 )
+		{
+			size_t offset = ( _offset + alignment-1 ) & ~( alignment-1 );
+			if( offset+size<=_blocks[_block].size() )
+			{
+				_offset = offset + size;
+				return &_blocks[_block][offset];
+			}
+		}
+
+		// Otherwise allocate a new block, at least twice the size of the previous one
+		size_t blockSize = _blocks.size() ? 2*_blocks.back().size() : DefaultBlockSize;
+		while( blockSize<size ) blockSize *= 2;
+		_blocks.emplace_back( blockSize );
+		_block = _blocks.size()-1;
+		_offset = size;
+		return &_blocks[_block][0];
+	}
+
+	inline size_t ScratchArena::capacity( void ) const
+	{
+		size_t capacity = 0;
+		for( size_t i=0 ; i<_blocks.size() ; i++ ) capacity += _blocks[i].size();
+		return capacity;
+	}
+
+	inline size_t ScratchArena::blockNum( void ) const { return _blocks.size(); }
+
+	inline ScratchArena &ScratchArena::Get( unsigned int tIdx ){ return (*_Arenas)[tIdx]; }
+}
@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <sstream>
+#include <limits>
+#include <Util/binaryStream.h>
 #include "shape.h"
+#include "scene.h"
 
 using namespace Ray;
 
@@ -12,12 +17,18 @@ using namespace Util;
 //////////////////////
 // ShapeBoundingBox //
 //////////////////////
-BoundingBox1D ShapeBoundingBox::intersect( const Ray3D &ray ) const
+BoundingBox1D ShapeBoundingBox::intersect( const Ray3D &ray , unsigned int tIdx ) const
 {
-	RayTracingStats::IncrementRayBoundingBoxIntersectionNum();
+	RayTracingStats::IncrementRayBoundingBoxIntersectionNum( tIdx );
 	return Util::BoundingBox3D::intersect( ray );
 }
 
+bool ShapeBoundingBox::intersect( const ReciprocalRay3D &ray , double &tMin , double &tMax , unsigned int tIdx ) const
+{
+	RayTracingStats::IncrementRayBoundingBoxIntersectionNum( tIdx );
+	return Util::BoundingBox3D::intersect( ray , tMin , tMax );
+}
+
 ///////////
 // Shape //
 ///////////
@@ -27,6 +38,42 @@ unsigned int Shape::WriteInsetSize = 0;
 
 void Shape::WriteInset( std::ostream &stream ){ for( unsigned int i=0 ; i<WriteInsetSize ; i++ ) stream << "  "; }
 
+void Shape::WriteBinary( std::ostream &stream , const Shape &shape ){ shape._writeBinary( stream ); }
+
+Shape *Shape::ReadBinary( std::istream &stream )
+{
+	std::string directive;
+	Util::ReadBinary( stream , directive );
+
+	// An empty directive indicates that the shape was written in text form
+	if( directive.empty() )
+	{
+		std::string text;
+		Util::ReadBinary( stream , text );
+		std::istringstream sStream( text );
+		return ReadShape( sStream , ShapeList::ShapeFactories );
+	}
+
+	std::unordered_map< std::string , BaseFactory< Shape > * >::const_iterator iter = ShapeList::ShapeFactories.find( directive );
+	if( iter==ShapeList::ShapeFactories.end() ) THROW( "unexpected shape directive: " , directive );
+	Shape *shape = iter->second->create();
+	if( !shape ) THROW( "failed to allocate memory for " , directive );
+	shape->_readBinary( stream );
+	return shape;
+}
+
+void Shape::_writeBinary( std::ostream &stream ) const
+{
+	// Write the text with enough digits that the values are recovered exactly
+	std::ostringstream sStream;
+	sStream.precision( std::numeric_limits< double >::max_digits10 );
+	sStream << *this;
+	Util::WriteBinary( stream , std::string() );
+	Util::WriteBinary( stream , sStream.str() );
+}
+
+void Shape::_readBinary( std::istream &stream ){ THROW( "binary format not supported for " , name() ); }
+
 ShapeBoundingBox Shape::boundingBox( void ) const { return _bBox; }
 
 size_t Shape::primitiveNum( void ) const { return _primitiveNum; }
@@ -43,21 +90,56 @@ void Shape::processOverlapping( const Filter &filter , const Kernel &kernel , Sh
 	if( filter( spInfo , *this )!=ShapeProcessingInfo::NONE ) kernel( spInfo , *this );
 }
 
+void Shape::processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	auto rFilter = []( double ){ return true; };
+	for( unsigned int i=0 ; i<packet.size ; i++ ) if( packet.mask & (1<<i) )
+	{
+		auto rKernel = [&]( const ShapeProcessingInfo &_spInfo , const RayShapeIntersectionInfo &iInfo )
+		{
+			packet.ranges[i][1][0] = iInfo.t;
+			rpKernel( i , _spInfo , iInfo );
+			return true;
+		};
+		processFirstIntersection( packet.rays[i] , packet.ranges[i] , rFilter , rKernel , spInfo , tIdx );
+	}
+}
+
+bool Shape::processAnyIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	bool terminated = false;
+	auto rKernel = [&]( const ShapeProcessingInfo &_spInfo , const RayShapeIntersectionInfo & )
+	{
+		if( !roKernel( _spInfo.material ) ) terminated = true;
+		return !terminated;
+	};
+	processAllIntersections( ray , range , rFilter , rKernel , spInfo , tIdx );
+	return terminated;
+}
+
 //////////////////////////
 // RayIntersectionStats //
 //////////////////////////
-std::atomic< size_t > RayTracingStats::_RayNum(0);
-std::atomic< size_t > RayTracingStats::_RayPrimitiveIntersectionNum(0);
-std::atomic< size_t > RayTracingStats::_RayBoundingBoxIntersectionNum(0);
-std::atomic< size_t > RayTracingStats::_ConeBoundingBoxIntersectionNum(0);
-
-void RayTracingStats::Reset( void ){ _RayNum = _RayPrimitiveIntersectionNum = _RayBoundingBoxIntersectionNum = _ConeBoundingBoxIntersectionNum = 0; }
-void RayTracingStats::IncrementRayNum( unsigned int count ){ _RayNum += count; }
-void RayTracingStats::IncrementRayPrimitiveIntersectionNum( unsigned int count ){ _RayPrimitiveIntersectionNum += count; }
-void RayTracingStats::IncrementRayBoundingBoxIntersectionNum( unsigned int count ){ _RayBoundingBoxIntersectionNum += count; }
-void RayTracingStats::IncrementConeBoundingBoxIntersectionNum( unsigned int count ){ _ConeBoundingBoxIntersectionNum += count; }
-
-size_t RayTracingStats::RayNum( void ){ return static_cast< size_t >( _RayNum ); }
-size_t RayTracingStats::RayPrimitiveIntersectionNum( void ){ return static_cast< size_t >( _RayPrimitiveIntersectionNum ); }
-size_t RayTracingStats::RayBoundingBoxIntersectionNum( void ){ return static_cast< size_t >( _RayBoundingBoxIntersectionNum ); }
-size_t RayTracingStats::ConeBoundingBoxIntersectionNum( void ){ return static_cast< size_t >( _ConeBoundingBoxIntersectionNum ); }
+#ifdef NO_RAY_TRACING_STATS
+void RayTracingStats::Reset( void ){}
+void RayTracingStats::Reserve( unsigned int ){}
+size_t RayTracingStats::_Value( unsigned int ){ return 0; }
+#else // !NO_RAY_TRACING_STATS
+Util::AlignedVector< RayTracingStats::_Counters > RayTracingStats::_Shards( 1 );
+
+void RayTracingStats::Reset( void ){ for( unsigned int i=0 ; i<_Shards.size() ; i++ ) _Shards[i] = _Counters(); }
+
+void RayTracingStats::Reserve( unsigned int threadNum ){ if( _Shards.size()<threadNum ) _Shards.resize( threadNum ); }
+
+size_t RayTracingStats::_Value( unsigned int counter )
+{
+	size_t value = 0;
+	for( unsigned int i=0 ; i<_Shards.size() ; i++ ) value += _Shards[i].values[counter];
+	return value;
+}
+#endif // NO_RAY_TRACING_STATS
+
+size_t RayTracingStats::RayNum( void ){ return _Value( _Counters::RAY ); }
+size_t RayTracingStats::RayPrimitiveIntersectionNum( void ){ return _Value( _Counters::RAY_PRIMITIVE ); }
+size_t RayTracingStats::RayBoundingBoxIntersectionNum( void ){ return _Value( _Counters::RAY_BOUNDING_BOX ); }
+size_t RayTracingStats::ConeBoundingBoxIntersectionNum( void ){ return _Value( _Counters::CONE_BOUNDING_BOX ); }
@@ -6,7 +6,9 @@
 #include <functional>
 #include <atomic>
 #include <Util/geometry.h>
+#include <Util/alignedAllocator.h>
 #include <Util/factory.h>
+#include <Util/functionReference.h>
 #include <GL/glew.h>
 #pragma warning( disable : 4290 )
 #ifdef __APPLE__
@@ -54,24 +56,87 @@ namespace Ray
 		static bool DebugFlag;
 	};
 
-	/** This class stores information about the number of rays cast and the number of ray-primitive intersections performed. */
+	/** This class stores information about the number of rays cast and the number of ray-primitive intersections performed.
+	*** Each thread increments its own (cache-line sized) set of counters, indexed by the thread, and the counters of all the threads are summed when the statistics are read.
+	*** Compiling with NO_RAY_TRACING_STATS defined removes the counting altogether (in which case all the statistics are reported as zero). */
 	struct RayTracingStats
 	{
-		static std::atomic< size_t > _RayNum;
-		static std::atomic< size_t > _RayPrimitiveIntersectionNum;
-		static std::atomic< size_t > _RayBoundingBoxIntersectionNum;
-		static std::atomic< size_t > _ConeBoundingBoxIntersectionNum;
-	public:
+#ifdef NO_RAY_TRACING_STATS
+		static const bool Enabled = false;
+#else // !NO_RAY_TRACING_STATS
+		static const bool Enabled = true;
+#endif // NO_RAY_TRACING_STATS
 
+		/** This method resets the statistics. It should not be called while other threads are ray-tracing. */
 		static void Reset( void );
-		static void IncrementRayNum( unsigned int count=1 );
-		static void IncrementRayPrimitiveIntersectionNum( unsigned int count=1 );
-		static void IncrementRayBoundingBoxIntersectionNum( unsigned int count=1 );
-		static void IncrementConeBoundingBoxIntersectionNum( unsigned int count=1 );
+
+		/** This method ensures that there are counters for (at least) the prescribed number of threads.
+		*** It should not be called while other threads are ray-tracing. */
+		static void Reserve( unsigned int threadNum );
+
+		static void IncrementRayNum( unsigned int tIdx , unsigned int count=1 );
+		static void IncrementRayPrimitiveIntersectionNum( unsigned int tIdx , unsigned int count=1 );
+		static void IncrementRayBoundingBoxIntersectionNum( unsigned int tIdx , unsigned int count=1 );
+		static void IncrementConeBoundingBoxIntersectionNum( unsigned int tIdx , unsigned int count=1 );
 		static size_t RayNum( void );
 		static size_t RayPrimitiveIntersectionNum( void );
 		static size_t RayBoundingBoxIntersectionNum( void );
 		static size_t ConeBoundingBoxIntersectionNum( void );
+
+	protected:
+		/** The set of counters of a thread, padded to fill a cache line so that threads do not write to the same line */
+		struct alignas( Util::CacheLineSize ) _Counters
+		{
+			enum
+			{
+				RAY ,
+				RAY_PRIMITIVE ,
+				RAY_BOUNDING_BOX ,
+				CONE_BOUNDING_BOX ,
+				COUNT
+			};
+			size_t values[ COUNT ];
+
+			_Counters( void ){ for( int i=0 ; i<COUNT ; i++ ) values[i] = 0; }
+		};
+
+		/** The counters, indexed by thread (only the thread itself writes to its counters) */
+		static Util::AlignedVector< _Counters > _Shards;
+
+		/** This method returns the value of the prescribed counter, summed over all threads. */
+		static size_t _Value( unsigned int counter );
+	};
+
+#ifdef NO_RAY_TRACING_STATS
+	inline void RayTracingStats::IncrementRayNum( unsigned int , unsigned int ){}
+	inline void RayTracingStats::IncrementRayPrimitiveIntersectionNum( unsigned int , unsigned int ){}
+	inline void RayTracingStats::IncrementRayBoundingBoxIntersectionNum( unsigned int , unsigned int ){}
+	inline void RayTracingStats::IncrementConeBoundingBoxIntersectionNum( unsigned int , unsigned int ){}
+#else // !NO_RAY_TRACING_STATS
+	inline void RayTracingStats::IncrementRayNum( unsigned int tIdx , unsigned int count ){ _Shards[tIdx].values[ _Counters::RAY ] += count; }
+	inline void RayTracingStats::IncrementRayPrimitiveIntersectionNum( unsigned int tIdx , unsigned int count ){ _Shards[tIdx].values[ _Counters::RAY_PRIMITIVE ] += count; }
+	inline void RayTracingStats::IncrementRayBoundingBoxIntersectionNum( unsigned int tIdx , unsigned int count ){ _Shards[tIdx].values[ _Counters::RAY_BOUNDING_BOX ] += count; }
+	inline void RayTracingStats::IncrementConeBoundingBoxIntersectionNum( unsigned int tIdx , unsigned int count ){ _Shards[tIdx].values[ _Counters::CONE_BOUNDING_BOX ] += count; }
+#endif // NO_RAY_TRACING_STATS
+
+	/** This class represents a packet of (coherent) rays that are traced together.
+	*** The i-th ray is active if the i-th bit of the mask is set. */
+	struct RayPacket
+	{
+		/** The maximum number of rays in a packet */
+		static const unsigned int MaxSize = 16;
+
+		/** The number of rays in the packet */
+		unsigned int size;
+
+		/** The bit-mask of active rays */
+		unsigned int mask;
+
+		/** The rays */
+		Util::Ray3D rays[ MaxSize ];
+
+		/** The ranges along the rays within which intersections are sought */
+		Util::BoundingBox1D ranges[ MaxSize ];
 	};
 
 	/** This class serves as a wrapper for Util::BoundingBox3D, calling RayTracingStats::IncrementRayBoundingBoxIntersectionNum before performing the intersection. */
@@ -82,7 +147,8 @@ namespace Ray
 		ShapeBoundingBox( const Util::BoundingBox3D &bBox ) : Util::BoundingBox3D( bBox ) {}
 		ShapeBoundingBox &operator = ( const ShapeBoundingBox &bBox ){ Util::BoundingBox3D::operator = ( bBox ) ; return *this; }
 		ShapeBoundingBox &operator = ( const Util::BoundingBox3D &bBox ){ Util::BoundingBox3D::operator = ( bBox ) ; return *this; }
-		Util::BoundingBox1D intersect( const Util::Ray3D &ray ) const;
+		Util::BoundingBox1D intersect( const Util::Ray3D &ray , unsigned int tIdx ) const;
+		bool intersect( const Util::ReciprocalRay3D &ray , double &tMin , double &tMax , unsigned int tIdx ) const;
 	};
 
 	/** This is the abstract class that all ray-traceable objects must implement. */
@@ -96,6 +162,13 @@ namespace Ray
 
 		/** This method reads the Shape from the stream (excluding the starting directive) */
 		virtual void _read( std::istream &stream ) = 0;
+
+		/** This method writes the Shape into the stream in the binary format of the scene cache (including the starting directive).
+		*** The default implementation writes an empty directive followed by the text form of the Shape. */
+		virtual void _writeBinary( std::ostream &stream ) const;
+
+		/** This method reads the Shape from the stream in the binary format of the scene cache (excluding the starting directive) */
+		virtual void _readBinary( std::istream &stream );
 	protected:
 		/** This member represents the bounding box of the shape. */
 		ShapeBoundingBox _bBox;
@@ -113,6 +186,12 @@ namespace Ray
 		/** This static method insets for writing. */
 		static void WriteInset( std::ostream &stream );
 
+		/** This static method writes the shape out to a stream in the binary format of the scene cache. */
+		static void WriteBinary( std::ostream &stream , const Shape &shape );
+
+		/** This static method reads a shape in from a stream in the binary format of the scene cache. */
+		static Shape *ReadBinary( std::istream &stream );
+
 		/** The destructor */
 		virtual ~Shape( void ){}
 
@@ -161,8 +240,11 @@ namespace Ray
 
 		typedef std::function< ShapeProcessingInfo::ProcessingType ( const ShapeProcessingInfo & , const Shape & ) > Filter;
 		typedef std::function< void ( const ShapeProcessingInfo & , const Shape & ) > Kernel;
-		typedef std::function< bool ( double ) > RayIntersectionFilter;
-		typedef std::function< bool ( const ShapeProcessingInfo & , const class RayShapeIntersectionInfo & ) > RayIntersectionKernel;
+		// The ray intersection filters and kernels are invoked for every intersection test, so they are passed as (non-owning) references rather than copied into std::function objects
+		typedef Util::FunctionReference< bool ( double ) > RayIntersectionFilter;
+		typedef Util::FunctionReference< bool ( const ShapeProcessingInfo & , const class RayShapeIntersectionInfo & ) > RayIntersectionKernel;
+		typedef Util::FunctionReference< void ( unsigned int , const ShapeProcessingInfo & , const class RayShapeIntersectionInfo & ) > RayPacketKernel;
+		typedef Util::FunctionReference< bool ( const class Material * ) > RayOcclusionKernel;
 
 		/** This method process Shapes by calling the "kernel" function on every shape whose bounding box passes the "filter" test.
 		* The tInfo parameter stores the accumulation of transformations encountered when traversing the scene-graph.
@@ -177,6 +259,17 @@ namespace Ray
 		* invoking the rKernel kernel with the intersection information. The processing terminates early if the kernel returns false. 
 		* The function returns the number of valid intersections. */
 		virtual int processAllIntersections( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const = 0;
+
+		/** This method processes the first shapes which intersect the active rays of the packet within their ranges, shrinking the ranges as intersections are found.
+		* The rpKernel kernel is invoked with the index of the ray and the intersection information whenever a closer intersection is found,
+		* so that the last invocation for a ray describes its first intersection. The default implementation processes the rays one at a time. */
+		virtual void processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+
+		/** This method processes the shapes which intersect the ray within the prescribed range and passing the rFilter test, in no particular order,
+		* invoking the roKernel kernel with the material at the point of intersection until the kernel returns false. (E.g. for occlusion queries.)
+		* Since only the materials are reported, the transformations in spInfo need not be accumulated. The function returns true if the kernel terminated the processing.
+		* The default implementation processes all the intersections. */
+		virtual bool processAnyIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 	};
 
 	/** This operator writes the shape out to a stream. */
@@ -1,4 +1,6 @@
+#include <limits>
 #include <Util/exceptions.h>
+#include <Util/binaryStream.h>
 #include "triangle.h"
 #include "shapeList.h"
 #include "scene.h"
@@ -51,6 +53,28 @@ int AffineShape::processAllIntersections( const Util::Ray3D &ray , const Util::B
 	return _shape->processAllIntersections( globalToLocal * ray , range , rFilter , rKernel , spInfo , tIdx );
 }
 
+void AffineShape::processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	Matrix4D globalToLocal = getInverseMatrix();
+	spInfo.globalToLocal = globalToLocal * spInfo.globalToLocal;
+	spInfo.localToGlobal = spInfo.localToGlobal * getMatrix();
+	spInfo.directionGlobalToLocal = Matrix3D( globalToLocal ) * spInfo.directionGlobalToLocal;
+	spInfo.normalLocalToGlobal = spInfo.normalLocalToGlobal * getNormalMatrix();
+
+	// The transformation does not change the parametrization of the rays, so the ranges carry over (only the active rays are copied)
+	RayPacket _packet;
+	_packet.size = packet.size , _packet.mask = packet.mask;
+	for( unsigned int i=0 ; i<packet.size ; i++ ) if( packet.mask & (1<<i) ) _packet.rays[i] = globalToLocal * packet.rays[i] , _packet.ranges[i] = packet.ranges[i];
+	_shape->processFirstIntersections( _packet , rpKernel , spInfo , tIdx );
+	for( unsigned int i=0 ; i<packet.size ; i++ ) if( packet.mask & (1<<i) ) packet.ranges[i] = _packet.ranges[i];
+}
+
+bool AffineShape::processAnyIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	// Only the materials are reported, so the transformations need not be accumulated
+	return _shape->processAnyIntersection( getInverseMatrix() * ray , range , rFilter , roKernel , spInfo , tIdx );
+}
+
 
 ///////////////////////
 // StaticAffineShape //
@@ -71,10 +95,22 @@ void StaticAffineShape::_write( std::ostream &stream ) const
 void StaticAffineShape::_read( std::istream &stream )
 {
 	if( !( stream >> _localTransform ) ) THROW( "Failed to parse " , Directive() );
-	if( _shape ) delete _shape;
 	_shape = ReadShape( stream , ShapeList::ShapeFactories );
 }
 
+void StaticAffineShape::_writeBinary( std::ostream &stream ) const
+{
+	Util::WriteBinary( stream , Directive() );
+	for( int i=0 ; i<4 ; i++ ) for( int j=0 ; j<4 ; j++ ) Util::WriteBinary( stream , _localTransform(i,j) );
+	Shape::WriteBinary( stream , *_shape );
+}
+
+void StaticAffineShape::_readBinary( std::istream &stream )
+{
+	for( int i=0 ; i<4 ; i++ ) for( int j=0 ; j<4 ; j++ ) Util::ReadBinary( stream , _localTransform(i,j) );
+	_shape = Shape::ReadBinary( stream );
+}
+
 void StaticAffineShape::initOpenGL( void ){ _shape->initOpenGL(); }
 
 Matrix4D StaticAffineShape::getMatrix( void ) const { return _localTransform; }
@@ -86,7 +122,7 @@ Matrix3D StaticAffineShape::getNormalMatrix( void ) const{ return _normalTransfo
 ////////////////////////
 // DynamicAffineShape //
 ////////////////////////
-DynamicAffineShape::DynamicAffineShape( void ) : AffineShape() , _matrix(NULL) {}
+DynamicAffineShape::DynamicAffineShape( void ) : AffineShape() , _matrix(NULL) , _inverseMatrix(NULL) , _normalMatrix(NULL) {}
 
 void DynamicAffineShape::_write( std::ostream &stream ) const
 {
@@ -100,23 +136,37 @@ void DynamicAffineShape::_write( std::ostream &stream ) const
 void DynamicAffineShape::_read( std::istream &stream )
 {
 	if( !( stream >> _paramName ) ) THROW( "Failed to parse " , Directive() );
-	if( _shape ) delete _shape;
 	_shape = ReadShape( stream , ShapeList::ShapeFactories );
 }
 
+void DynamicAffineShape::_writeBinary( std::ostream &stream ) const
+{
+	Util::WriteBinary( stream , Directive() );
+	Util::WriteBinary( stream , _paramName );
+	Shape::WriteBinary( stream , *_shape );
+}
+
+void DynamicAffineShape::_readBinary( std::istream &stream )
+{
+	Util::ReadBinary( stream , _paramName );
+	_shape = Shape::ReadBinary( stream );
+}
+
 void DynamicAffineShape::init( const LocalSceneData &data )
 {
 	if( !data.keyFrameFile ) THROW( "no key-frame file" );
 	_matrix = &data.keyFrameFile->keyFrameMatrices.current( _paramName );
+	_inverseMatrix = &data.keyFrameFile->currentInverse( _paramName );
+	_normalMatrix = &data.keyFrameFile->currentNormal( _paramName );
 	_shape->init( data );
 	_primitiveNum = _shape->primitiveNum();
 }
 
 Matrix4D DynamicAffineShape::getMatrix( void ) const { return *_matrix; }
 
-Matrix4D DynamicAffineShape::getInverseMatrix( void ) const { return getMatrix().inverse(); }
+Matrix4D DynamicAffineShape::getInverseMatrix( void ) const { return *_inverseMatrix; }
 
-Matrix3D DynamicAffineShape::getNormalMatrix( void ) const { return getMatrix().inverse().transpose(); }
+Matrix3D DynamicAffineShape::getNormalMatrix( void ) const { return *_normalMatrix; }
 
 ////////////////
 // Difference //
@@ -157,6 +207,19 @@ void Difference::_read( std::istream &stream )
 	else THROW( "unexpected directive in group " , name() , ": " , keyword );
 }
 
+void Difference::_writeBinary( std::ostream &stream ) const
+{
+	Util::WriteBinary( stream , Directive() );
+	Shape::WriteBinary( stream , *_shape0 );
+	Shape::WriteBinary( stream , *_shape1 );
+}
+
+void Difference::_readBinary( std::istream &stream )
+{
+	_shape0 = Shape::ReadBinary( stream );
+	_shape1 = Shape::ReadBinary( stream );
+}
+
 void Difference::init( const LocalSceneData& data )
 {
 	_shape0->init( data ) , _shape1->init( data );
@@ -183,6 +246,80 @@ bool ShapeBoundingBoxHit::Compare( const ShapeBoundingBoxHit &v1 , const ShapeBo
 ///////////////
 std::unordered_map< std::string , BaseFactory< Shape > * > ShapeList::ShapeFactories;
 
+bool ShapeList::UseBVH = false;
+
+void ShapeList::_updateBVH( void )
+{
+	if( !UseBVH || shapes.size()<2 ){ _bvh.clear() ; return; }
+
+	std::vector< BoundingBox3D > bBoxes( shapes.size() );
+	for( unsigned int i=0 ; i<shapes.size() ; i++ ) bBoxes[i] = shapes[i]->boundingBox();
+	_bvh.set( bBoxes );
+}
+
+bool ShapeList::_processFirstIntersectionBVH( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	BoundingBox1D _range = range;
+	ShapeProcessingInfo hitSPInfo;
+	RayShapeIntersectionInfo hitIInfo;
+	bool hit = false;
+
+	// Record the closest intersection, shrinking the range so that farther nodes and shapes are culled
+	auto kernel = [&]( const ShapeProcessingInfo &_spInfo , const RayShapeIntersectionInfo &_iInfo )
+	{
+		if( _iInfo.t<hitIInfo.t )
+		{
+			hitSPInfo = _spInfo , hitIInfo = _iInfo;
+			_range[1][0] = _iInfo.t;
+			hit = true;
+		}
+		return true;
+	};
+
+	_bvh.traverse( ray , _range , [&]( unsigned int begin , unsigned int end )
+	{
+		for( unsigned int i=begin ; i<end ; i++ ) shapes[ _bvh.index(i) ]->processFirstIntersection( ray , _range , rFilter , kernel , spInfo , tIdx );
+		return false;
+	} , tIdx );
+
+	if( hit ) rKernel( hitSPInfo , hitIInfo );
+	return hit;
+}
+
+void ShapeList::processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	// Without a hierarchy the packet is passed to every child (which is how the first intersection with the list is defined)
+	if( _bvh.empty() )
+	{
+		for( int i=0 ; i<shapes.size() ; i++ ) shapes[i]->processFirstIntersections( packet , rpKernel , spInfo , tIdx );
+		return;
+	}
+
+	unsigned int mask = packet.mask;
+	_bvh.traverse( packet , [&]( unsigned int begin , unsigned int end , unsigned int _mask )
+	{
+		packet.mask = _mask;
+		for( unsigned int i=begin ; i<end ; i++ ) shapes[ _bvh.index(i) ]->processFirstIntersections( packet , rpKernel , spInfo , tIdx );
+	} , tIdx );
+	packet.mask = mask;
+}
+
+bool ShapeList::processAnyIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	if( _bvh.empty() )
+	{
+		for( int i=0 ; i<shapes.size() ; i++ ) if( shapes[i]->processAnyIntersection( ray , range , rFilter , roKernel , spInfo , tIdx ) ) return true;
+		return false;
+	}
+
+	BoundingBox1D _range = range;
+	return _bvh.traverse( ray , _range , [&]( unsigned int begin , unsigned int end )
+	{
+		for( unsigned int i=begin ; i<end ; i++ ) if( shapes[ _bvh.index(i) ]->processAnyIntersection( ray , range , rFilter , roKernel , spInfo , tIdx ) ) return true;
+		return false;
+	} , tIdx );
+}
+
 void ShapeList::_read( std::istream &stream )
 {
 	string endDirective = _DirectiveHeader() + string( "_end" );
@@ -216,6 +353,21 @@ void ShapeList::_write( std::ostream &stream ) const
 	stream << "#" << _DirectiveHeader() << "_end";
 }
 
+void ShapeList::_writeBinary( std::ostream &stream ) const
+{
+	Util::WriteBinary( stream , Directive() );
+	Util::WriteBinary( stream , (uint64_t)shapes.size() );
+	for( int i=0 ; i<shapes.size() ; i++ ) Shape::WriteBinary( stream , *shapes[i] );
+}
+
+void ShapeList::_readBinary( std::istream &stream )
+{
+	uint64_t count;
+	Util::ReadBinary( stream , count );
+	shapes.reserve( shapes.size() + (size_t)count );
+	for( uint64_t i=0 ; i<count ; i++ ) shapes.push_back( Shape::ReadBinary( stream ) );
+}
+
 void ShapeList::addTrianglesOpenGL( std::vector< TriangleIndex >& triangles )
 {
 	for( int i=0 ; i<shapes.size() ; i++ ) shapes[i]->addTrianglesOpenGL( triangles );
@@ -240,6 +392,8 @@ void ShapeList::processOverlapping( const Filter &filter , const Kernel &kernel
 //////////////////
 // TriangleList //
 //////////////////
+bool TriangleList::Compact = false;
+
 TriangleList::TriangleList( void ) : _vertices(NULL) , _vNum(0) , _vertexBufferID(0) , _elementBufferID(0){}
 
 void TriangleList::_write( std::ostream &stream ) const
@@ -259,6 +413,61 @@ void TriangleList::_read( std::istream &stream )
 	ShapeList::_read( stream );
 }
 
+void TriangleList::_writeBinary( std::ostream &stream ) const
+{
+	Util::WriteBinary( stream , Directive() );
+	Util::WriteBinary( stream , _materialIndex );
+
+	// If all the children are triangles, their vertex indices are written as a single array rather than shape by shape
+	std::vector< uint32_t > indices;
+	indices.reserve( 3*shapes.size() );
+	bool isMesh = true;
+	for( int i=0 ; i<shapes.size() && isMesh ; i++ )
+	{
+		const Triangle *triangle = dynamic_cast< const Triangle * >( shapes[i] );
+		if( !triangle ) isMesh = false;
+		else for( int j=0 ; j<3 ; j++ )
+		{
+			if( triangle->_vIndices[j]>std::numeric_limits< uint32_t >::max() ) isMesh = false;
+			indices.push_back( (uint32_t)triangle->_vIndices[j] );
+		}
+	}
+	Util::WriteBinary( stream , (uint8_t)( isMesh ? 1 : 0 ) );
+	if( isMesh ) Util::WriteBinary( stream , indices );
+	else ShapeList::_writeBinary( stream );
+}
+
+void TriangleList::_readBinary( std::istream &stream )
+{
+	uint8_t isMesh;
+	Util::ReadBinary( stream , _materialIndex );
+	Util::ReadBinary( stream , isMesh );
+	if( isMesh )
+	{
+		std::vector< uint32_t > indices;
+		Util::ReadBinary( stream , indices );
+		if( indices.size()%3 ) THROW( "vertex index count is not a multiple of three for " , name() , ": " , indices.size() );
+		// Create the triangles through the factory, so that they are owned by (and allocated contiguously in) the bound factory storage
+		std::unordered_map< std::string , Util::BaseFactory< Shape > * >::const_iterator iter = ShapeList::ShapeFactories.find( Triangle::Directive() );
+		if( iter==ShapeList::ShapeFactories.end() ) THROW( "no factory for " , Triangle::Directive() );
+		shapes.reserve( shapes.size() + indices.size()/3 );
+		for( size_t i=0 ; i<indices.size() ; i+=3 )
+		{
+			Triangle *triangle = dynamic_cast< Triangle * >( iter->second->create() );
+			if( !triangle ) THROW( "failed to create " , Triangle::Directive() );
+			for( int j=0 ; j<3 ; j++ ) triangle->_vIndices[j] = indices[i+j];
+			shapes.push_back( triangle );
+		}
+	}
+	else
+	{
+		string keyword;
+		Util::ReadBinary( stream , keyword );
+		if( keyword!=ShapeList::Directive() ) THROW( name() , " expects next shape to be: " , ShapeList::Directive() );
+		ShapeList::_readBinary( stream );
+	}
+}
+
 void TriangleList::processOverlapping( const Filter &filter , const Kernel &kernel , ShapeProcessingInfo spInfo ) const
 {
 	spInfo.material = _material;
@@ -268,9 +477,30 @@ void TriangleList::processOverlapping( const Filter &filter , const Kernel &kern
 bool TriangleList::processFirstIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
 	spInfo.material = _material;
+	if( !_meshBVH.empty() ) return _processFirstIntersectionMesh( ray , range , rFilter , rKernel , spInfo , tIdx );
 	return ShapeList::processFirstIntersection( ray , range , rFilter , rKernel , spInfo , tIdx );
 }
 
+void TriangleList::processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	spInfo.material = _material;
+	if( _meshBVH.empty() ) return ShapeList::processFirstIntersections( packet , rpKernel , spInfo , tIdx );
+
+	_meshBVH.intersect( packet , [&]( unsigned int i , unsigned int triangle , double b1 , double b2 )
+	{
+		RayShapeIntersectionInfo iInfo;
+		_setIntersectionInfo( packet.rays[i] , packet.ranges[i][1][0] , triangle , b1 , b2 , spInfo , iInfo );
+		rpKernel( i , spInfo , iInfo );
+	} , tIdx );
+}
+
+bool TriangleList::processAnyIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	spInfo.material = _material;
+	if( _meshBVH.empty() ) return ShapeList::processAnyIntersection( ray , range , rFilter , roKernel , spInfo , tIdx );
+	return _meshBVH.intersectAny( ray , range , rFilter , [&]( unsigned int ){ return roKernel( _material ); } , tIdx );
+}
+
 int TriangleList::processAllIntersections( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
 	spInfo.material = _material;
@@ -297,6 +527,20 @@ void Union::_read( std::istream &stream )
 	stream >> _shapeList;
 }
 
+void Union::_writeBinary( std::ostream &stream ) const
+{
+	Util::WriteBinary( stream , Directive() );
+	_shapeList._writeBinary( stream );
+}
+
+void Union::_readBinary( std::istream &stream )
+{
+	string keyword;
+	Util::ReadBinary( stream , keyword );
+	if( keyword!=ShapeList::Directive() ) THROW( name() , " expects next shape to be: " , ShapeList::Directive() );
+	_shapeList._readBinary( stream );
+}
+
 void Union::drawOpenGL( GLSLProgram *glslProgram ) const
 {
 	THROW( "OpenGL rendering not supported for " , name() );
@@ -327,6 +571,20 @@ void Intersection::_read( std::istream &stream )
 	stream >> _shapeList;
 }
 
+void Intersection::_writeBinary( std::ostream &stream ) const
+{
+	Util::WriteBinary( stream , Directive() );
+	_shapeList._writeBinary( stream );
+}
+
+void Intersection::_readBinary( std::istream &stream )
+{
+	string keyword;
+	Util::ReadBinary( stream , keyword );
+	if( keyword!=ShapeList::Directive() ) THROW( name() , " expects next shape to be: " , ShapeList::Directive() );
+	_shapeList._readBinary( stream );
+}
+
 void Intersection::drawOpenGL( GLSLProgram *glslProgram ) const
 {
 	THROW( "OpenGL rendering not supported for " , name() );
@@ -336,3 +594,76 @@ void Intersection::initOpenGL( void )
 {
 	THROW( "OpenGL rendering not supported for " , name() );
 }
+
+void TriangleList::_setMeshBVH( void )
+{
+	_meshBVH.clear();
+	_meshIndices.clear();
+	_bvh.clear();
+	if( !UseBVH || !shapes.size() ) return;
+
+	// The children may also be (trivial) shape lists, in which case the generic path is used
+	std::vector< const Triangle * > triangles( shapes.size() );
+	for( int i=0 ; i<shapes.size() ; i++ ) if( !( triangles[i] = dynamic_cast< const Triangle * >( shapes[i] ) ) ) return;
+
+	_meshBVH.set( triangles.size() , [&]( size_t i , Point3D p[3] ){ for( int j=0 ; j<3 ; j++ ) p[j] = _vertices[ triangles[i]->_vIndices[j] ].position; } , TriangleBVH::DefaultLeafSize , Compact );
+
+	// Copy the vertex indices so that shading a hit does not need to dereference the triangle
+	if( Compact )
+	{
+		_meshIndices.resize( 3*triangles.size() );
+		for( size_t i=0 ; i<triangles.size() ; i++ ) for( int j=0 ; j<3 ; j++ ) _meshIndices[3*i+j] = (uint32_t)triangles[i]->_vIndices[j];
+	}
+}
+
+void TriangleList::_updateBVH( void )
+{
+	// The triangle hierarchy is built (once) when the list is initialized. Until then the children's bounding boxes are not defined,
+	// and afterwards the hierarchy over the children is redundant if the triangle hierarchy has been built.
+	if( _vertices && _meshBVH.empty() ) ShapeList::_updateBVH();
+	else _bvh.clear();
+}
+
+bool TriangleList::_processFirstIntersectionMesh( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+{
+	BoundingBox1D _range = range;
+	unsigned int tri = 0;
+	double b1 = 0 , b2 = 0;
+	if( !_meshBVH.intersect( ray , _range , rFilter , tri , b1 , b2 , tIdx ) ) return false;
+
+	RayShapeIntersectionInfo iInfo;
+	_setIntersectionInfo( ray , _range[1][0] , tri , b1 , b2 , spInfo , iInfo );
+	rKernel( spInfo , iInfo );
+	return true;
+}
+
+void TriangleList::_setIntersectionInfo( const Ray3D &ray , double t , unsigned int tri , double b1 , double b2 , const ShapeProcessingInfo &spInfo , RayShapeIntersectionInfo &iInfo ) const
+{
+	size_t vIndices[3];
+	if( _meshIndices.size() ) for( int j=0 ; j<3 ; j++ ) vIndices[j] = _meshIndices[3*tri+j];
+	else for( int j=0 ; j<3 ; j++ ) vIndices[j] = static_cast< const Triangle * >( shapes[tri] )->_vIndices[j];
+	const Vertex &v0 = _vertices[ vIndices[0] ] , &v1 = _vertices[ vIndices[1] ] , &v2 = _vertices[ vIndices[2] ];
+	double b0 = 1. - b1 - b2;
+
+	iInfo.t = t;
+	Point3D normal = v0.normal * b0 + v1.normal * b1 + v2.normal * b2;
+	// Fall back on the face normal if the vertices do not have normals
+	if( !normal.squareNorm() ) normal = Point3D::CrossProduct( v1.position - v0.position , v2.position - v0.position );
+	iInfo.position = spInfo.localToGlobal * ray( t );
+	iInfo.normal = ( spInfo.normalLocalToGlobal * normal ).unit();
+	iInfo.texture = v0.texCoordinate * b0 + v1.texCoordinate * b1 + v2.texCoordinate * b2;
+
+	// The gradients of the barycentric coordinates within the plane of the triangle give the gradients of the texture coordinates,
+	// which are covectors and so are transformed to world coordinates like normals.
+	// They are only used to filter textures, so they are not computed for untextured materials.
+	if( spInfo.material && spInfo.material->tex )
+	{
+		Point3D e1 = v1.position - v0.position , e2 = v2.position - v0.position , n = Point3D::CrossProduct( e1 , e2 );
+		double nn = n.squareNorm();
+		if( nn>0 )
+		{
+			Point3D g1 = Point3D::CrossProduct( e2 , n ) / nn , g2 = Point3D::CrossProduct( n , e1 ) / nn;
+			for( int i=0 ; i<2 ; i++ ) iInfo.textureGradients[i] = spInfo.normalLocalToGlobal * ( g1 * ( v1.texCoordinate[i]-v0.texCoordinate[i] ) + g2 * ( v2.texCoordinate[i]-v0.texCoordinate[i] ) );
+		}
+	}
+}
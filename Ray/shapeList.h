@@ -1,9 +1,12 @@
 #ifndef GROUP_INCLUDED
 #define GROUP_INCLUDED
 #include <vector>
+#include <cstdint>
 #include <unordered_map>
 #include <Util/geometry.h>
 #include "shape.h"
+#include "scratchArena.h"
+#include "bvh.h"
 
 namespace Ray
 {
@@ -34,6 +37,8 @@ namespace Ray
 		void updateBoundingBox( void );
 		bool processFirstIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 		int processAllIntersections( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		void processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		bool processAnyIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 		void processOverlapping( const Filter &filter , const Kernel &kernel , ShapeProcessingInfo tInfo ) const;
 		virtual bool isInside( Util::Point3D p ) const;
 		virtual void drawOpenGL( GLSLProgram *glslProgram ) const;
@@ -67,6 +72,8 @@ namespace Ray
 	private:
 		void _write( std::ostream &stream ) const;
 		void _read( std::istream &stream );
+		void _writeBinary( std::ostream &stream ) const;
+		void _readBinary( std::istream &stream );
 	public:
 		std::string name( void ) const { return "static affine"; }
 		void init( const class LocalSceneData &data );
@@ -89,6 +96,12 @@ namespace Ray
 
 		/** A pointer to the matrix storing the current transformation  */
 		const Util::Matrix4D *_matrix;
+
+		/** A pointer to the matrix storing the inverse of the current transformation  */
+		const Util::Matrix4D *_inverseMatrix;
+
+		/** A pointer to the matrix storing the normal transformation of the current transformation  */
+		const Util::Matrix3D *_normalMatrix;
 	public:
 
 		/** The default constructor */
@@ -103,6 +116,8 @@ namespace Ray
 	private:
 		void _write( std::ostream &stream ) const;
 		void _read( std::istream &stream );
+		void _writeBinary( std::ostream &stream ) const;
+		void _readBinary( std::istream &stream );
 	public:
 		std::string name( void ) const { return "dynamic affine"; }
 		void init( const class LocalSceneData &data );
@@ -135,6 +150,8 @@ namespace Ray
 	private:
 		void _write( std::ostream &stream ) const;
 		void _read( std::istream &stream );
+		void _writeBinary( std::ostream &stream ) const;
+		void _readBinary( std::istream &stream );
 	public:
 		std::string name( void ) const { return "difference"; }
 		void init( const class LocalSceneData& data );
@@ -171,7 +188,18 @@ namespace Ray
 
 		/** This static method returns the directive header describing the shape. */
 		static std::string _DirectiveHeader( void ){ return "shape_list"; }
+	protected:
+		/** The bounding volume hierarchy over the shapes (empty if it has not been built) */
+		BVH _bvh;
+
+		/** This method (re)builds the bounding volume hierarchy over the shapes' bounding boxes, if requested. */
+		virtual void _updateBVH( void );
+
+		/** This method processes the first intersection by traversing the bounding volume hierarchy front-to-back. */
+		bool _processFirstIntersectionBVH( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 	public:
+		/** A global variable indicating if a bounding volume hierarchy should be built over the shapes of a list */
+		static bool UseBVH;
 
 		/** The set of shape factoendDirectiveries */
 		static std::unordered_map< std::string , Util::BaseFactory< Shape > * > ShapeFactories;
@@ -188,6 +216,8 @@ namespace Ray
 	protected:
 		void _write( std::ostream &stream ) const;
 		void _read( std::istream &stream );
+		void _writeBinary( std::ostream &stream ) const;
+		void _readBinary( std::istream &stream );
 	public:
 		std::string name( void ) const { return "shape list"; }
 		void init( const class LocalSceneData &data );
@@ -195,6 +225,8 @@ namespace Ray
 		void updateBoundingBox( void );
 		bool processFirstIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 		int processAllIntersections( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		void processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		bool processAnyIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 		void processOverlapping( const Filter &filter , const Kernel &kernel , ShapeProcessingInfo tInfo ) const;
 		bool isInside( Util::Point3D p ) const;
 		void drawOpenGL( GLSLProgram * glslProgram ) const;
@@ -226,10 +258,31 @@ namespace Ray
 
 		/** The material associated to all triangles within the list */
 		const class Material *_material;
+
+		/** The bounding volume hierarchy over the triangles' positions (empty if it has not been built) */
+		TriangleBVH _meshBVH;
+
+		/** The (32-bit) indices of the triangles' vertices, three per triangle, used to interpolate the vertex attributes at a hit (empty unless the mesh is compact) */
+		std::vector< uint32_t > _meshIndices;
+
+		/** This method builds the bounding volume hierarchy over the triangles' positions, if requested and if all the children are triangles.
+		*** It is only called when the list is initialized, and it discards the hierarchy over the children, so that at most one of the two hierarchies is built. */
+		void _setMeshBVH( void );
+
+		/** This method processes the first intersection by traversing the triangle hierarchy and interpolating the vertex attributes at the closest hit. */
+		bool _processFirstIntersectionMesh( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+
+		/** This method computes the intersection information for a hit on the prescribed triangle, given the barycentric coordinates of the second and third vertices. */
+		void _setIntersectionInfo( const Util::Ray3D &ray , double t , unsigned int triangle , double b1 , double b2 , const ShapeProcessingInfo &spInfo , class RayShapeIntersectionInfo &iInfo ) const;
+	protected:
+		void _updateBVH( void );
 	public:
 		/** This static method returns the directive header describing the shape. */
 		static std::string Directive( void ){ return "shape_triangles"; }
 
+		/** A global variable indicating if the triangle hierarchy should store the positions in single precision and the vertex indices in 32 bits */
+		static bool Compact;
+
 		/** The default constructor */
 		TriangleList( void );
 
@@ -239,12 +292,16 @@ namespace Ray
 	private:
 		void _write( std::ostream &stream ) const;
 		void _read( std::istream &stream );
+		void _writeBinary( std::ostream &stream ) const;
+		void _readBinary( std::istream &stream );
 	public:
 		std::string name( void ) const { return "triangles"; }
 		void init( const class LocalSceneData &data );
 		void initOpenGL( void );
 		bool processFirstIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 		int processAllIntersections( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		void processFirstIntersections( RayPacket &packet , const RayPacketKernel &rpKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
+		bool processAnyIntersection( const Util::Ray3D &ray , const Util::BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayOcclusionKernel &roKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const;
 		void processOverlapping( const Filter &filter , const Kernel &kernel , ShapeProcessingInfo tInfo ) const;
 		void drawOpenGL( GLSLProgram * glslProgram ) const;
 	};
@@ -264,6 +321,8 @@ namespace Ray
 	private:
 		void _write( std::ostream &stream ) const;
 		void _read( std::istream &stream );
+		void _writeBinary( std::ostream &stream ) const;
+		void _readBinary( std::istream &stream );
 	public:
 		std::string name( void ) const { return "union"; }
 		void init( const class LocalSceneData &data );
@@ -292,6 +351,8 @@ namespace Ray
 	private:
 		void _write( std::ostream &stream ) const;
 		void _read( std::istream &stream );
+		void _writeBinary( std::ostream &stream ) const;
+		void _readBinary( std::istream &stream );
 	public:
 		std::string name( void ) const { return "intersection"; }
 		void init( const class LocalSceneData &data );
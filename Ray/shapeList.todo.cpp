@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <Util/exceptions.h>
 #include <Util/threads.h>
 #include "shapeList.h"
@@ -48,11 +49,47 @@ bool Difference::isInside( Util::Point3D p ) const
 ///////////////
 bool ShapeList::processFirstIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
+	// If a bounding volume hierarchy has been built, use it to find the closest intersection
+	if( !_bvh.empty() ) return _processFirstIntersectionBVH( ray , range , rFilter , rKernel , spInfo , tIdx );
+
 	//////////////////////////////////////////////////////////////////
 	// Compute the intersection of the shape list with the ray here //
 	//////////////////////////////////////////////////////////////////
-	WARN_ONCE( "method undefined" );
-	return false;
+	// Intersect the ray with the children's bounding boxes, storing the hits in the thread's scratch memory (released on leaving the scope)
+	ScratchArena &arena = ScratchArena::Get( tIdx );
+	ScratchArena::Scope scope( arena );
+	ShapeBoundingBoxHit *hits = arena.allocate< ShapeBoundingBoxHit >( shapes.size() );
+	unsigned int hitNum = 0;
+	ReciprocalRay3D _ray( ray );
+	for( unsigned int i=0 ; i<shapes.size() ; i++ )
+	{
+		double tMin = range[0][0] , tMax = range[1][0];
+		if( shapes[i]->boundingBox().intersect( _ray , tMin , tMax , tIdx ) ) hits[hitNum].t = tMin , hits[hitNum++].shape = shapes[i];
+	}
+	std::sort( hits , hits+hitNum , ShapeBoundingBoxHit::Compare );
+
+	BoundingBox1D _range = range;
+	ShapeProcessingInfo hitSPInfo;
+	RayShapeIntersectionInfo hitIInfo;
+	bool hit = false;
+
+	// Record the closest intersection, shrinking the range so that farther shapes are culled
+	auto kernel = [&]( const ShapeProcessingInfo &_spInfo , const RayShapeIntersectionInfo &_iInfo )
+	{
+		if( _iInfo.t<hitIInfo.t )
+		{
+			hitSPInfo = _spInfo , hitIInfo = _iInfo;
+			_range[1][0] = _iInfo.t;
+			hit = true;
+		}
+		return true;
+	};
+
+	// Process the children front-to-back, stopping once the closest intersection precedes the remaining bounding boxes
+	for( unsigned int i=0 ; i<hitNum && hits[i].t<=_range[1][0] ; i++ ) hits[i].shape->processFirstIntersection( ray , _range , rFilter , kernel , spInfo , tIdx );
+
+	if( hit ) rKernel( hitSPInfo , hitIInfo );
+	return hit;
 }
 
 int ShapeList::processAllIntersections( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
@@ -89,6 +126,9 @@ void ShapeList::updateBoundingBox( void )
 	// Set the _bBox object here //
 	///////////////////////////////
 	WARN_ONCE( "method undefined" );
+
+	// Rebuild the bounding volume hierarchy over the (updated) bounding boxes of the children
+	_updateBVH();
 }
 
 void ShapeList::initOpenGL( void )
@@ -189,6 +229,9 @@ void TriangleList::init( const LocalSceneData &data )
 
 	ShapeList::init( data );
 
+	// Pack the triangles into the mesh hierarchy (if requested)
+	_setMeshBVH();
+
 	///////////////////////////////////
 	// Do any additional set-up here //
 	///////////////////////////////////
@@ -43,7 +43,7 @@ void Sphere::initOpenGL( void )
 
 bool Sphere::processFirstIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
-	RayTracingStats::IncrementRayPrimitiveIntersectionNum();
+	RayTracingStats::IncrementRayPrimitiveIntersectionNum( tIdx );
 	spInfo.material = _material;
 
 	//////////////////////////////////////////////////////////////
@@ -55,7 +55,7 @@ bool Sphere::processFirstIntersection( const Ray3D &ray , const BoundingBox1D &r
 
 int Sphere::processAllIntersections( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
 {
-	RayTracingStats::IncrementRayPrimitiveIntersectionNum();
+	RayTracingStats::IncrementRayPrimitiveIntersectionNum( tIdx );
 	spInfo.material = _material;
 
 	//////////////////////////////////////////////////////////////
@@ -19,6 +19,31 @@ void SphereLight::_read( std::istream &stream )
 	if( !stream ) THROW( "Failed to parse " , Directive() );
 }
 
+Point3D SphereLight::sample( Point3D p , Point2D u ) const
+{
+	Point3D w = _location - p;
+	double d2 = w.squareNorm() , r2 = _radius*_radius;
+	double phi = 2. * M_PI * u[1];
+
+	// If the point is inside the light, sample the sphere uniformly
+	if( d2<=r2 )
+	{
+		double z = 1. - 2.*u[0] , r = sqrt( std::max< double >( 0. , 1.-z*z ) );
+		return _location + Point3D( r*cos(phi) , r*sin(phi) , z ) * _radius;
+	}
+
+	// Otherwise sample the cone of directions subtended by the light uniformly and intersect the sampled ray with the sphere
+	double d = sqrt( d2 );
+	w /= d;
+	Point3D a = fabs( w[0] )>0.9 ? Point3D( 0. , 1. , 0. ) : Point3D( 1. , 0. , 0. );
+	Point3D uAxis = Point3D::CrossProduct( a , w ).unit() , vAxis = Point3D::CrossProduct( w , uAxis );
+
+	double cosThetaMax = sqrt( std::max< double >( 0. , 1. - r2/d2 ) );
+	double cosTheta = 1. - u[0] * ( 1. - cosThetaMax ) , sinTheta = sqrt( std::max< double >( 0. , 1. - cosTheta*cosTheta ) );
+	double t = d*cosTheta - sqrt( std::max< double >( 0. , r2 - d2*sinTheta*sinTheta ) );
+	return p + ( w*cosTheta + ( uAxis*cos(phi) + vAxis*sin(phi) )*sinTheta ) * t;
+}
+
 void SphereLight::_write( std::ostream &stream ) const
 {
 	stream << "#" << Directive() << "  " << _ambient << "  " << _diffuse << "  " << _specular << "  " << _location << "  " << _radius << " " << _constAtten << " " << _linearAtten << " " << _quadAtten;
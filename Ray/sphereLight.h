@@ -26,6 +26,10 @@ namespace Ray
 		void _read( std::istream &stream );
 	public:
 		std::string name( void ) const { return "sphere light"; }
+
+		/** This method maps a point in [0,1)^2 to a point on the part of the light's surface that is visible from p, distributed uniformly over the solid angle the light subtends at p.
+		*** (If p is inside the light, the point is distributed uniformly over the whole surface.) Stratified points in [0,1)^2 map to stratified points on the light. */
+		Util::Point3D sample( Util::Point3D p , Util::Point2D u ) const;
 		Util::Point3D transparency( const class RayShapeIntersectionInfo &iInfo , const class Shape &shape , Util::Point3D cLimit , unsigned int samples , unsigned int tIdx ) const;
 	};
 }
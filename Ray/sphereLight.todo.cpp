@@ -15,6 +15,14 @@ Point3D SphereLight::transparency( const RayShapeIntersectionInfo &iInfo , const
 	//////////////////////////////////////////////////////////
 	// Compute the transparency along the path to the light //
 	//////////////////////////////////////////////////////////
-	WARN_ONCE( "method undefined" );
-	return PointLight::transparency( iInfo , shape , cLimit , samples , tIdx );
+	if( !samples ) return PointLight::transparency( iInfo , shape , cLimit , samples , tIdx );
+
+	// Average the transparency along the paths to stratified positions on the light, stopping early outside of the penumbra
+	auto sampleFunction = [&]( Point2D u )
+	{
+		Point3D v = sample( iInfo.position , u ) - iInfo.position;
+		double distance = v.length();
+		return _Transmittance( shape , Ray3D( iInfo.position , v / distance ) , BoundingBox1D( Epsilon , distance ) , cLimit , tIdx );
+	};
+	return Sampler::Get( tIdx ).integrate( samples , sampleFunction , cLimit );
 }
\ No newline at end of file
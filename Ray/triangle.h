@@ -30,6 +30,8 @@ namespace Ray
 	/** This class represents a triangle and is specified by three pointers to the three vertices that define it. */
 	class Triangle : public Shape
 	{
+		friend class TriangleList;
+
 		/** The indices of the vertices associated with the Triangle */
 		size_t _vIndices[3];
 
@@ -0,0 +1,56 @@
+#ifndef ALIGNED_ALLOCATOR_INCLUDED
+#define ALIGNED_ALLOCATOR_INCLUDED
+
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace Util
+{
+	/** The size (in bytes) of a cache line */
+	static const size_t CacheLineSize = 64;
+
+	/** This templated class is an allocator (for use with std::vector) that guarantees that the allocated memory starts on an Alignment-byte boundary.
+	*** The memory is obtained from malloc, over-allocating so that the aligned address and a pointer to the original allocation can be stored. */
+	template< typename T , size_t Alignment=CacheLineSize >
+	class AlignedAllocator
+	{
+		static_assert( ( Alignment & (Alignment-1) )==0 , "[ERROR] Alignment must be a power of two" );
+	public:
+		typedef T value_type;
+
+		template< typename _T > struct rebind { typedef AlignedAllocator< _T , Alignment > other; };
+
+		/** The default constructor */
+		AlignedAllocator( void ){}
+
+		/** The copy constructor from an allocator of a different type */
+		template< typename _T >
+		AlignedAllocator( const AlignedAllocator< _T , Alignment > & ){}
+
+		/** This method allocates memory for count objects of type T */
+		T *allocate( size_t count )
+		{
+			void *memory = malloc( count*sizeof(T) + Alignment + sizeof(void*) );
+			if( !memory ) throw std::bad_alloc();
+			uintptr_t address = ( reinterpret_cast< uintptr_t >( memory ) + sizeof(void*) + Alignment-1 ) & ~( (uintptr_t)Alignment-1 );
+			( reinterpret_cast< void ** >( address ) )[-1] = memory;
+			return reinterpret_cast< T * >( address );
+		}
+
+		/** This method deallocates memory that was allocated by the allocator */
+		void deallocate( T *t , size_t ){ if( t ) free( ( reinterpret_cast< void ** >( t ) )[-1] ); }
+
+		template< typename _T >
+		bool operator == ( const AlignedAllocator< _T , Alignment > & ) const { return true; }
+
+		template< typename _T >
+		bool operator != ( const AlignedAllocator< _T , Alignment > & ) const { return false; }
+	};
+
+	/** A vector whose storage starts on an Alignment-byte boundary */
+	template< typename T , size_t Alignment=CacheLineSize >
+	using AlignedVector = std::vector< T , AlignedAllocator< T , Alignment > >;
+}
+#endif // ALIGNED_ALLOCATOR_INCLUDED
@@ -0,0 +1,193 @@
+#ifndef BINARY_STREAM_INCLUDED
+#define BINARY_STREAM_INCLUDED
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <streambuf>
+#include <type_traits>
+#include <climits>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !defined( _WIN32 ) && !defined( _WIN64 )
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif // !_WIN32 && !_WIN64
+#include "exceptions.h"
+
+namespace Util
+{
+	/** This function writes the (trivially copyable) value out to the stream in binary. */
+	template< typename T >
+	void WriteBinary( std::ostream &stream , const T &value )
+	{
+		static_assert( std::is_trivially_copyable< T >::value , "[ERROR] Only trivially copyable types can be written in binary" );
+		stream.write( reinterpret_cast< const char * >( &value ) , sizeof(T) );
+	}
+
+	/** This function reads the (trivially copyable) value in from the stream in binary. */
+	template< typename T >
+	void ReadBinary( std::istream &stream , T &value )
+	{
+		static_assert( std::is_trivially_copyable< T >::value , "[ERROR] Only trivially copyable types can be read in binary" );
+		if( !stream.read( reinterpret_cast< char * >( &value ) , sizeof(T) ) ) THROW( "failed to read binary value" );
+	}
+
+	/** This function writes the string out to the stream in binary, preceded by its length. */
+	inline void WriteBinary( std::ostream &stream , const std::string &str )
+	{
+		WriteBinary( stream , (uint64_t)str.size() );
+		stream.write( str.c_str() , str.size() );
+	}
+
+	/** This function reads the string in from the stream in binary. */
+	inline void ReadBinary( std::istream &stream , std::string &str )
+	{
+		uint64_t size;
+		ReadBinary( stream , size );
+		str.resize( (size_t)size );
+		if( size && !stream.read( &str[0] , (std::streamsize)size ) ) THROW( "failed to read binary string" );
+	}
+
+	/** This function writes the vector of (trivially copyable) values out to the stream in binary, preceded by its size. */
+	template< typename T >
+	void WriteBinary( std::ostream &stream , const std::vector< T > &values )
+	{
+		static_assert( std::is_trivially_copyable< T >::value , "[ERROR] Only trivially copyable types can be written in binary" );
+		WriteBinary( stream , (uint64_t)values.size() );
+		if( values.size() ) stream.write( reinterpret_cast< const char * >( &values[0] ) , sizeof(T)*values.size() );
+	}
+
+	/** This function reads the vector of (trivially copyable) values in from the stream in binary. */
+	template< typename T >
+	void ReadBinary( std::istream &stream , std::vector< T > &values )
+	{
+		static_assert( std::is_trivially_copyable< T >::value , "[ERROR] Only trivially copyable types can be read in binary" );
+		uint64_t size;
+		ReadBinary( stream , size );
+		values.resize( (size_t)size );
+		if( size && !stream.read( reinterpret_cast< char * >( &values[0] ) , (std::streamsize)( sizeof(T)*size ) ) ) THROW( "failed to read binary array" );
+	}
+
+	/** This function returns the 64-bit FNV-1a hash of the data, continuing from the prescribed hash. */
+	inline uint64_t Hash( const char *data , size_t size , uint64_t hash=0xcbf29ce484222325ull )
+	{
+		for( size_t i=0 ; i<size ; i++ ) hash = ( hash ^ (unsigned char)data[i] ) * 0x100000001b3ull;
+		return hash;
+	}
+
+	/** This class describes the state of a file on disk, used to detect when a file derived from it is out of date. */
+	struct FileStamp
+	{
+		/** The modification time of the file */
+		int64_t time;
+
+		/** The size (in bytes) of the file */
+		uint64_t size;
+
+		/** The constructor, reading the state of the file (and throwing if the file does not exist) */
+		FileStamp( const std::string &fileName )
+		{
+			struct stat s;
+			if( stat( fileName.c_str() , &s ) ) THROW( "failed to stat file: " , fileName );
+			time = (int64_t)s.st_mtime , size = (uint64_t)s.st_size;
+		}
+
+		/** This static method returns the hash of the contents of the file. */
+		static uint64_t Hash( const std::string &fileName )
+		{
+			std::ifstream stream( fileName , std::ios::binary );
+			if( !stream ) THROW( "failed to open file for reading: " , fileName );
+			std::vector< char > buffer( 1<<16 );
+			uint64_t hash = 0xcbf29ce484222325ull;
+			while( stream.read( &buffer[0] , buffer.size() ) || stream.gcount() ) hash = Util::Hash( &buffer[0] , (size_t)stream.gcount() , hash );
+			return hash;
+		}
+	};
+
+	/** This class exposes a range of memory as a read-only stream buffer, so that it can be read through a std::istream without copying. */
+	class MemoryStreamBuffer : public std::streambuf
+	{
+	public:
+		MemoryStreamBuffer( const char *begin , size_t size )
+		{
+			char *_begin = const_cast< char * >( begin );
+			setg( _begin , _begin , _begin+size );
+		}
+	protected:
+		std::streamsize xsgetn( char *s , std::streamsize count )
+		{
+			std::streamsize available = egptr()-gptr();
+			if( count>available ) count = available;
+			memcpy( s , gptr() , (size_t)count );
+			// The get pointer can only be advanced by an int at a time, so large reads are advanced in chunks
+			for( std::streamsize remaining=count ; remaining>0 ; )
+			{
+				int step = (int)std::min< std::streamsize >( remaining , INT_MAX );
+				gbump( step );
+				remaining -= step;
+			}
+			return count;
+		}
+	};
+
+	/** This class maps a file into (read-only) memory for the lifetime of the object.
+	*** On platforms without mmap the contents of the file are read into memory instead. */
+	class MappedFile
+	{
+		const char *_data;
+		size_t _size;
+#if defined( _WIN32 ) || defined( _WIN64 )
+		std::vector< char > _buffer;
+#endif // _WIN32 || _WIN64
+	public:
+		MappedFile( const std::string &fileName ) : _data(NULL) , _size(0)
+		{
+#if defined( _WIN32 ) || defined( _WIN64 )
+			std::ifstream stream( fileName , std::ios::binary | std::ios::ate );
+			if( !stream ) THROW( "failed to open file for reading: " , fileName );
+			_buffer.resize( (size_t)stream.tellg() );
+			stream.seekg( 0 );
+			if( _buffer.size() && !stream.read( &_buffer[0] , _buffer.size() ) ) THROW( "failed to read file: " , fileName );
+			_data = _buffer.size() ? &_buffer[0] : NULL , _size = _buffer.size();
+#else // !_WIN32 && !_WIN64
+			int fd = open( fileName.c_str() , O_RDONLY );
+			if( fd<0 ) THROW( "failed to open file for reading: " , fileName );
+			struct stat s;
+			if( fstat( fd , &s ) ){ close( fd ) ; THROW( "failed to stat file: " , fileName ); }
+			_size = (size_t)s.st_size;
+			if( _size )
+			{
+				void *data = mmap( NULL , _size , PROT_READ , MAP_PRIVATE , fd , 0 );
+				if( data==MAP_FAILED ){ close( fd ) ; THROW( "failed to map file: " , fileName ); }
+				// The data is read sequentially, so have the kernel read ahead aggressively
+				madvise( data , _size , MADV_SEQUENTIAL );
+				_data = (const char *)data;
+			}
+			// The mapping remains valid after the file descriptor is closed
+			close( fd );
+#endif // _WIN32 || _WIN64
+		}
+
+		~MappedFile( void )
+		{
+#if !defined( _WIN32 ) && !defined( _WIN64 )
+			if( _data ) munmap( const_cast< char * >( _data ) , _size );
+#endif // !_WIN32 && !_WIN64
+		}
+
+		MappedFile( const MappedFile & ) = delete;
+		MappedFile &operator = ( const MappedFile & ) = delete;
+
+		/** This method returns a pointer to the start of the file's contents */
+		const char *data( void ) const { return _data; }
+
+		/** This method returns the size (in bytes) of the file */
+		size_t size( void ) const { return _size; }
+	};
+}
+#endif // BINARY_STREAM_INCLUDED
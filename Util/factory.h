@@ -2,44 +2,110 @@
 #define FACTORY_INCLUDED
 
 #include <type_traits>
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+#include "exceptions.h"
 
 namespace Util
 {
-	/** This templated class represents a factory for generating objects of type BaseType.
-	  * It tracks the objects created and deletes them in the destructor. */
-	template< typename BaseType >
-	class BaseFactory
+	/** This class represents the storage in which factories construct objects: blocks of memory in which the objects are laid out contiguously, in the order in which they are created
+	  * (so that objects created in succession, e.g. the siblings in a scene-graph, are contiguous in memory, and creating an object does not require a heap allocation).
+	  * The storage owns the objects, destroying them and freeing the blocks all at once when it is cleared or destroyed.
+	  * Factories construct their objects in the storage that is currently bound. */
+	class FactoryStorage
 	{
-		/** The list of BaseType created by the factory */
-		std::vector< BaseType * > _baseTypes;
+		/** The blocks of memory, and the size (in bytes) of each */
+		std::vector< std::pair< char * , size_t > > _blocks;
 
-		/** The virtual method creating an object of type BaseType on the heap */
-		virtual BaseType *_create( void ) = 0;
+		/** The number of bytes used in the last block */
+		size_t _used;
+
+		/** The objects constructed in the storage, together with the functions destroying them, in the order in which they were constructed */
+		std::vector< std::pair< void * , void (*)( void * ) > > _objects;
+
+		/** This function returns a reference to the currently bound storage */
+		static FactoryStorage *&_Bound( void ){ static FactoryStorage *bound = NULL ; return bound; }
+
+		template< typename T >
+		static void _Destroy( void *t ){ static_cast< T * >( t )->~T(); }
 
 	public:
-		/** The destructor is responsible for deallocating all the BaseType created */
-		virtual ~BaseFactory( void ){ for( int i=0 ; i<_baseTypes.size() ; i++ ) delete _baseTypes[i]; }
+		/** The size (in bytes) of the first block */
+		static const size_t FirstBlockSize = 1<<12;
 
-		/** The (publicly accessible) method for creating a new object */
-		BaseType *create( void )
+		/** The maximum size (in bytes) of a block (beyond which the block sizes stop doubling) */
+		static const size_t MaxBlockSize = 1<<24;
+
+		FactoryStorage( void ) : _used(0) {}
+		~FactoryStorage( void ){ clear(); }
+
+		FactoryStorage( const FactoryStorage & ) = delete;
+		FactoryStorage &operator = ( const FactoryStorage & ) = delete;
+
+		/** This method destroys the objects (in the reverse order of their construction) and frees the blocks */
+		void clear( void )
 		{
-			BaseType *baseType = _create();
-			_baseTypes.push_back( baseType );
-			return baseType;
+			for( size_t i=_objects.size() ; i!=0 ; i-- ) _objects[i-1].second( _objects[i-1].first );
+			for( size_t b=0 ; b<_blocks.size() ; b++ ) ::operator delete( _blocks[b].first );
+			_objects.clear();
+			_blocks.clear();
+			_used = 0;
 		}
 
-		/** The method for creating a new derived object */
-		template< typename DerivedType >
-		BaseType *create( void )
+		/** This method default-constructs an object of type T in the storage */
+		template< typename T >
+		T *construct( void )
 		{
-			static_assert( std::is_base_of< BaseType , DerivedType >::value , "[ERROR] BaseType must be base of DerivedType" );
-			BaseType *baseType = new DerivedType();
-			_baseTypes.push_back( baseType );
-			return baseType;
+			static_assert( alignof( T )<=alignof( std::max_align_t ) , "[ERROR] T cannot be over-aligned" );
+			// Every object starts on a maximally aligned boundary
+			const size_t size = ( ( sizeof(T) + alignof( std::max_align_t ) - 1 ) / alignof( std::max_align_t ) ) * alignof( std::max_align_t );
+			if( !_blocks.size() || _used+size>_blocks.back().second )
+			{
+				size_t blockSize = _blocks.size() ? std::min< size_t >( 2*_blocks.back().second , MaxBlockSize ) : FirstBlockSize;
+				blockSize = std::max< size_t >( blockSize , size );
+				_blocks.push_back( std::make_pair( static_cast< char * >( ::operator new( blockSize ) ) , blockSize ) );
+				_used = 0;
+			}
+			T *t = new( _blocks.back().first + _used ) T();
+			_used += size;
+			_objects.push_back( std::make_pair( static_cast< void * >( t ) , &_Destroy< T > ) );
+			return t;
 		}
+
+		/** This static method returns the currently bound storage (or NULL if none is bound) */
+		static FactoryStorage *Bound( void ){ return _Bound(); }
+
+		/** This class binds the storage for its lifetime, restoring the previously bound storage when it is destroyed */
+		class Binding
+		{
+			FactoryStorage *_previous;
+		public:
+			Binding( FactoryStorage &storage ) : _previous( _Bound() ){ _Bound() = &storage; }
+			~Binding( void ){ _Bound() = _previous; }
+
+			Binding( const Binding & ) = delete;
+			Binding &operator = ( const Binding & ) = delete;
+		};
 	};
 
-	/** This derived template class is a factory for creating derived objects of type DerivedType */
+	/** This templated class represents a factory for generating objects of type BaseType. */
+	template< typename BaseType >
+	class BaseFactory
+	{
+		/** The virtual method creating an object of type BaseType */
+		virtual BaseType *_create( void ) = 0;
+
+	public:
+		virtual ~BaseFactory( void ){}
+
+		/** The (publicly accessible) method for creating a new object */
+		BaseType *create( void ){ return _create(); }
+	};
+
+	/** This derived template class is a factory for creating derived objects of type DerivedType.
+	  * The objects are constructed in (and owned by) the currently bound FactoryStorage, rather than allocated individually on the heap. */
 	template< typename BaseType , typename DerivedType >
 	class DerivedFactory : public BaseFactory< BaseType >
 	{
@@ -48,7 +114,12 @@ namespace Util
 		/////////////////////////////////////
 		// BaseFactory< BaseType > methods //
 		/////////////////////////////////////
-		BaseType *_create( void ){ return new DerivedType(); }
+		BaseType *_create( void )
+		{
+			FactoryStorage *storage = FactoryStorage::Bound();
+			if( !storage ) THROW( "no factory storage bound" );
+			return storage->construct< DerivedType >();
+		}
 	};
 }
 #endif // FACTORY_INCLUDED
@@ -0,0 +1,35 @@
+#ifndef FUNCTION_REFERENCE_INCLUDED
+#define FUNCTION_REFERENCE_INCLUDED
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace Util
+{
+	template< typename Signature > class FunctionReference;
+
+	/** This templated class is a non-owning reference to a callable object, with the prescribed signature.
+	  * Unlike std::function it does not copy (or allocate) the callable, so it is cheap to construct and pass around,
+	  * but the referenced callable must outlive the reference. (Typically it is constructed from a lambda passed as a function argument.) */
+	template< typename Return , typename ... Arguments >
+	class FunctionReference< Return ( Arguments ... ) >
+	{
+		/** The address of the referenced callable */
+		void *_callable;
+
+		/** The function invoking the referenced callable */
+		Return ( *_invoke )( void * , Arguments ... );
+
+		template< typename Callable >
+		static Return _Invoke( void *callable , Arguments ... arguments ){ return ( *static_cast< typename std::remove_reference< Callable >::type * >( callable ) )( std::forward< Arguments >( arguments ) ... ); }
+	public:
+		/** The constructor referencing the callable */
+		template< typename Callable , typename = typename std::enable_if< !std::is_same< typename std::decay< Callable >::type , FunctionReference >::value >::type >
+		FunctionReference( Callable &&callable ) : _callable( const_cast< void * >( static_cast< const void * >( std::addressof( callable ) ) ) ) , _invoke( _Invoke< Callable > ){}
+
+		/** This operator invokes the referenced callable */
+		Return operator()( Arguments ... arguments ) const { return _invoke( _callable , std::forward< Arguments >( arguments ) ... ); }
+	};
+}
+#endif // FUNCTION_REFERENCE_INCLUDED
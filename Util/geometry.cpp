@@ -40,25 +40,6 @@ namespace Util
 	//////////////////////
 	bool GlobalProperties::DebugFlag = false;
 
-	////////////////
-	// Quaternion //
-	////////////////
-	Quaternion::Quaternion( double r , Point3D i ) : real(r) , imag(i) {}
-
-	Quaternion Quaternion::additiveInverse( void ) const { return Quaternion( -real , -imag ); }
-
-	Quaternion Quaternion::multiplicativeInverse( void ) const { return conjugate() * ( 1./squareNorm() ); }
-
-	double Quaternion::dot( const Quaternion &q ) const { return real*q.real + Point3D::Dot( imag , q.imag ); }
-
-	Quaternion Quaternion::operator * ( double scale ) const { return Quaternion( real*scale , imag*scale ); }
-
-	Quaternion Quaternion::operator + ( const Quaternion &q ) const { return Quaternion( real+q.real , imag + q.imag ); }
-
-	Quaternion Quaternion::operator * ( const Quaternion &q ) const { return Quaternion( real*q.real - Point3D::Dot( imag , q.imag ) , imag*q.real + q.imag*real + Point3D::CrossProduct( imag , q.imag ) ); }
-
-	Quaternion Quaternion::conjugate( void ) const { return Quaternion( real , -imag ); }
-
 	//////////////////////////////
 	// TrivialRotationParameter //
 	//////////////////////////////
@@ -46,15 +46,26 @@ namespace Util
 		static bool DebugFlag;
 	};
 
-	/** This templated class represents a Dim-dimenaional vector */
-	template< unsigned int Dim >
-	class Point : public InnerProductSpace< Point< Dim > >
+	/** This templated structure describes the tolerance used for geometric comparisons (e.g. for offsetting rays from surfaces) at the precision of the scalar type.
+	*** The tolerance is relative, so it should be scaled by the magnitude of the quantities being compared. */
+	template< typename Real > struct Tolerance;
+
+	template<> struct Tolerance< double >{ static double Epsilon( void ){ return Util::Epsilon; } };
+
+	/** In single precision the tolerance is a few hundred units in the last place, since a double precision tolerance would be below the rounding error. */
+	template<> struct Tolerance< float >{ static float Epsilon( void ){ return 512.f * std::numeric_limits< float >::epsilon(); } };
+
+	/** This templated class represents a Dim-dimenaional vector, with coefficients of type Real */
+	template< unsigned int Dim , typename Real=double >
+	class Point : public InnerProductSpace< Point< Dim , Real > >
 	{
-		/** The coordinates of the point */
-		double _p[Dim];
+		/** The coordinates of the point (aligned so that even-dimensional double precision points can be loaded in pairs by the SIMD kernels) */
+		alignas( Dim%2 ? alignof(Real) : 2*sizeof(Real) ) Real _p[Dim];
 
 		/** Initializes coordinate values from an array */
-		void _init( const double *values , unsigned int sz );
+		void _init( const Real *values , unsigned int sz );
+
+		template< unsigned int _Dim , typename _Real > friend class Point;
 	public:
 		/** Default constructor, initializes coefficients to zero. */
 		Point( void );
@@ -62,15 +73,19 @@ namespace Util
 		/** Copy constructor */
 		Point( const Point &p );
 
+		/** This constructor converts a point with coefficients of a different type. */
+		template< typename _Real >
+		explicit Point( const Point< Dim , _Real > &p );
+
 		/** Variadic constructor. Assumes the number of values is equal to the dimension and that all values are doubles. */
 		template< typename ... Doubles >
 		Point( Doubles ... values );
 
 		/** This method returns a reference to the indexed coefficient.*/
-		double &operator[] ( int index );
+		Real &operator[] ( int index );
 
 		/** This method returns a reference to the indexed coefficient.*/
-		const double &operator[] ( int index ) const;
+		const Real &operator[] ( int index ) const;
 
 		/** This method performs a component-wise multiplication of two ponts and returns the product. */
 		Point  operator *  ( const Point &p ) const;
@@ -109,38 +124,42 @@ namespace Util
 	};
 
 	/** A zero-dimensional point does not really make sense */
-	template<> class Point< 0 >{};
+	template< typename Real > class Point< 0 , Real >{};
 
 	/** Functionality for outputing a point to a stream.*/
-	template< unsigned int Dim >
-	std::ostream &operator << ( std::ostream &stream , const Point< Dim > &p );
+	template< unsigned int Dim , typename Real >
+	std::ostream &operator << ( std::ostream &stream , const Point< Dim , Real > &p );
 
 	/** Functionality for inputing a point from a stream.*/
-	template< unsigned int Dim >
-	std::istream &operator >> ( std::istream &stream , Point< Dim > &p );
+	template< unsigned int Dim , typename Real >
+	std::istream &operator >> ( std::istream &stream , Point< Dim , Real > &p );
 
 	/** This templated class represents a general rectangular, Rows x Cols, matrix that is the base for both rectangular and square matrices
 	*  Matrices are stored in row-major order. */
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
 	class _BaseMatrix
 	{
-		/** The actual matrix entries */
-		double _m[Rows][Cols];
+		/** The actual matrix entries (aligned so that the rows of double precision matrices with an even number of columns can be loaded in pairs by the SIMD kernels) */
+		alignas( Cols%2 ? alignof(Real) : 2*sizeof(Real) ) Real _m[Rows][Cols];
 	public:
 		/** The default constructor generates a zero matrix */
 		_BaseMatrix( void );
 
+		/** This constructor converts a matrix with entries of a different type. */
+		template< typename _MatrixType , typename _MatrixTransposeType , typename _Real >
+		explicit _BaseMatrix( const _BaseMatrix< Rows , Cols , _MatrixType , _MatrixTransposeType , _Real > &m );
+
 		/** This method returns the entry of the matrix in the r-th row and the c-th column.*/
-		double &operator() ( int r , int c );
+		Real &operator() ( int r , int c );
 
 		/** This method returns the entry of the matrix in the r-th row and the c-th column.*/
-		const double &operator() ( int r , int c ) const;
+		const Real &operator() ( int r , int c ) const;
 
 		/** This method returns the transpose of a matrix.*/
 		MatrixTransposeType transpose( void ) const;
 
 		/** This method transforms a Dim-dimensional point by applying the linear transformation. */
-		Point< Rows > operator * ( const Point< Cols > &p ) const;	
+		Point< Rows , Real > operator * ( const Point< Cols , Real > &p ) const;	
 
 		/////////////////////
 		// Algebra methods //
@@ -159,47 +178,47 @@ namespace Util
 	};
 
 
-	template< unsigned int Rows , unsigned int Cols > class Matrix;
+	template< unsigned int Rows , unsigned int Cols , typename Real=double > class Matrix;
 
-	/** This templated class represents a Rows x Cols matrix.
+	/** This templated class represents a Rows x Cols matrix, with entries of type Real.
 	*  Matrices are stored in row-major order. */
-	template< unsigned int Rows , unsigned int Cols >
-	class Matrix : public _BaseMatrix< Rows , Cols , Matrix< Rows , Cols > , Matrix< Cols , Rows > > , InnerProductSpace< Matrix< Rows , Cols > >
+	template< unsigned int Rows , unsigned int Cols , typename Real >
+	class Matrix : public _BaseMatrix< Rows , Cols , Matrix< Rows , Cols , Real > , Matrix< Cols , Rows , Real > , Real > , InnerProductSpace< Matrix< Rows , Cols , Real > >
 	{
 	public:
 		/** Expose the constructors/methods of the base class */
-		using _BaseMatrix< Rows , Cols , Matrix< Rows , Cols > , Matrix< Cols , Rows > >::_BaseMatrix;
-		using _BaseMatrix< Rows , Cols , Matrix< Rows , Cols > , Matrix< Cols , Rows > >::operator *;
-		using _BaseMatrix< Rows , Cols , Matrix< Rows , Cols > , Matrix< Cols , Rows > >::operator ();
-		using _BaseMatrix< Rows , Cols , Matrix< Rows , Cols > , Matrix< Cols , Rows > >::transpose;
+		using _BaseMatrix< Rows , Cols , Matrix< Rows , Cols , Real > , Matrix< Cols , Rows , Real > , Real >::_BaseMatrix;
+		using _BaseMatrix< Rows , Cols , Matrix< Rows , Cols , Real > , Matrix< Cols , Rows , Real > , Real >::operator *;
+		using _BaseMatrix< Rows , Cols , Matrix< Rows , Cols , Real > , Matrix< Cols , Rows , Real > , Real >::operator ();
+		using _BaseMatrix< Rows , Cols , Matrix< Rows , Cols , Real > , Matrix< Cols , Rows , Real > , Real >::transpose;
 
 		/** The default constructor that initializes the matrix to zero.*/
 		Matrix( void );
 
 		/** Multiplication of matrices */
 		template< unsigned int _Cols >
-		Matrix< Rows , _Cols > operator * ( const Matrix< Cols , _Cols > &m ) const;
+		Matrix< Rows , _Cols , Real > operator * ( const Matrix< Cols , _Cols , Real > &m ) const;
 	};
 
 	/** Specialization of the matrix class for the case when it is square. */
-	template< unsigned int Dim >
-	class Matrix< Dim , Dim > : public _BaseMatrix< Dim , Dim , Matrix< Dim , Dim > , Matrix< Dim , Dim > > , public InnerProductSpace< Matrix< Dim , Dim > > , Algebra< Matrix< Dim , Dim > >
+	template< unsigned int Dim , typename Real >
+	class Matrix< Dim , Dim , Real > : public _BaseMatrix< Dim , Dim , Matrix< Dim , Dim , Real > , Matrix< Dim , Dim , Real > , Real > , public InnerProductSpace< Matrix< Dim , Dim , Real > > , Algebra< Matrix< Dim , Dim , Real > >
 	{
 	public:
 		/** Expose the constructors/methods of the base class */
-		using _BaseMatrix< Dim , Dim , Matrix< Dim , Dim > , Matrix< Dim , Dim > >::_BaseMatrix;
-		using _BaseMatrix< Dim , Dim , Matrix< Dim , Dim > , Matrix< Dim , Dim > >::operator *;
-		using _BaseMatrix< Dim , Dim , Matrix< Dim , Dim > , Matrix< Dim , Dim > >::operator ();
-		using _BaseMatrix< Dim , Dim , Matrix< Dim , Dim > , Matrix< Dim , Dim > >::transpose;
+		using _BaseMatrix< Dim , Dim , Matrix< Dim , Dim , Real > , Matrix< Dim , Dim , Real > , Real >::_BaseMatrix;
+		using _BaseMatrix< Dim , Dim , Matrix< Dim , Dim , Real > , Matrix< Dim , Dim , Real > , Real >::operator *;
+		using _BaseMatrix< Dim , Dim , Matrix< Dim , Dim , Real > , Matrix< Dim , Dim , Real > , Real >::operator ();
+		using _BaseMatrix< Dim , Dim , Matrix< Dim , Dim , Real > , Matrix< Dim , Dim , Real > , Real >::transpose;
 
 		/** The default constructor that initializes the matrix to zero.*/
 		Matrix( void );
 
 		/** This constructor generates a matrix by slicing out the top left sub-matrix*/
-		Matrix( const Matrix< Dim+1 , Dim+1 > &m );
+		Matrix( const Matrix< Dim+1 , Dim+1 , Real > &m );
 
 		/** This constructor generates matrix by projectivizing the input matrix, using m as the linear part and p as the translation.*/
-		Matrix( const Matrix< Dim-1 , Dim-1 > &m , Point< Dim-1 > p = Point< Dim-1 >() );
+		Matrix( const Matrix< Dim-1 , Dim-1 , Real > &m , Point< Dim-1 , Real > p = Point< Dim-1 , Real >() );
 
 		/** This method returns the determinant of the sub-matrix with the prescribed columns and rows removed. */
 		double subDeterminant( int r , int c ) const;
@@ -219,7 +238,7 @@ namespace Util
 		bool setInverse( Matrix &m ) const;
 
 		/** This method transforms a (Dim-1)-dimensional point by applying the projective transformation. */
-		Point< Dim-1 > operator * ( const Point< Dim-1 > &p ) const;
+		Point< Dim-1 , Real > operator * ( const Point< Dim-1 , Real > &p ) const;
 
 		/** This static method returns the identity matrix. */
 		static Matrix Identity( void );
@@ -251,16 +270,16 @@ namespace Util
 		/////////////////////
 		/** Multiplication of matrices */
 		template< unsigned int Cols >
-		Matrix< Dim , Cols > operator * ( const Matrix< Dim , Cols > &m ) const;
+		Matrix< Dim , Cols , Real > operator * ( const Matrix< Dim , Cols , Real > &m ) const;
 	};
 
 	/** Functionality for outputing a matrices to a stream.*/
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	std::ostream &operator << ( std::ostream &stream , const _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType > &m );
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	std::ostream &operator << ( std::ostream &stream , const _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real > &m );
 
 	/** Functionality for inputting a matrix from a stream.*/
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	std::istream &operator >> ( std::istream &stream , _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType > &m );
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	std::istream &operator >> ( std::istream &stream , _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real > &m );
 
 
 	/** This templated class represents a hyperplane in Dim dimensions. */
@@ -294,77 +313,108 @@ namespace Util
 	};
 
 	/** This templated class represents a Ray.*/
-	template< unsigned int Dim >
+	template< unsigned int Dim , typename Real=double >
 	class Ray
 	{
 	public:
 		/** The starting point of the ray */
-		Point< Dim > position;
+		Point< Dim , Real > position;
 
 		/** The direction of the ray */
-		Point< Dim > direction;
+		Point< Dim , Real > direction;
 
 		/** The default constructor */
 		Ray( void );
 
 		/** The constructor settign the the position and direction of the ray */
-		Ray( const Point< Dim > &position , const Point< Dim > &direction );
+		Ray( const Point< Dim , Real > &position , const Point< Dim , Real > &direction );
+
+		/** This constructor converts a ray with coefficients of a different type. */
+		template< typename _Real >
+		explicit Ray( const Ray< Dim , _Real > &ray );
 
 		/** This method computes the translation of the ray by p and returns the translated ray.*/
-		Ray  operator +  ( const Point< Dim > &p ) const;
+		Ray  operator +  ( const Point< Dim , Real > &p ) const;
 
 		/** This method translates the current ray by p.*/
-		Ray &operator += ( const Point< Dim > &p );
+		Ray &operator += ( const Point< Dim , Real > &p );
 
 		/** This method computes the translation of the ray by -p and returns the translated ray.*/
-		Ray  operator -  ( const Point< Dim > &p ) const;
+		Ray  operator -  ( const Point< Dim , Real > &p ) const;
 
 		/** This method translates the current ray by -p.*/
-		Ray &operator -= ( const Point< Dim > &p );
+		Ray &operator -= ( const Point< Dim , Real > &p );
 
 		/** This method returns the point at a distance of t along the ray. */
-		Point< Dim > operator() ( double t ) const;
+		Point< Dim , Real > operator() ( Real t ) const;
 	};
 
 	/** This method applies a transformation to a ray.*/
-	template< unsigned int Dim >
-	Ray< Dim > operator * ( const Matrix< Dim+1 , Dim+1 > &m , const Ray< Dim > &ray );
+	template< unsigned int Dim , typename Real >
+	Ray< Dim , Real > operator * ( const Matrix< Dim+1 , Dim+1 , Real > &m , const Ray< Dim , Real > &ray );
 
 	/** This function prints out the ray.*/
-	template< unsigned int Dim >
-	std::ostream &operator << ( std::ostream &stream , const Ray< Dim > &ray )
+	template< unsigned int Dim , typename Real >
+	std::ostream &operator << ( std::ostream &stream , const Ray< Dim , Real > &ray )
 	{
 		stream << "[ " << ray.position << " ] [ " << ray.direction << " ]";
 		return stream;
 	}
 
+	/** This templated class represents a ray prepared for repeated intersection with axis-aligned boxes.
+	*** It stores the reciprocal of the direction and, for each axis, the index of the box corner that the ray enters the slab through,
+	*** so that it can be constructed once and then tested against every box in a traversal without divisions or branches. */
+	template< unsigned int Dim , typename Real=double >
+	class ReciprocalRay
+	{
+	public:
+		/** The starting point of the ray */
+		Point< Dim , Real > position;
+
+		/** The reciprocals of the coefficients of the direction (infinite if the coefficient is zero) */
+		Point< Dim , Real > inverseDirection;
+
+		/** For each axis, the index (0 or 1) of the corner of a box through which the ray enters the slab */
+		unsigned int sign[Dim];
+
+		/** The default constructor */
+		ReciprocalRay( void );
+
+		/** This constructor prepares the ray for intersection */
+		ReciprocalRay( const Ray< Dim , Real > &ray );
+	};
+
 	/** This templated class represents a bounding box.
 	*** If any of the coefficients of the first corner are greater than or equal to the coefficients of the second, the bounding box is assumed to be empty. */
-	template< unsigned int Dim >
+	template< unsigned int Dim , typename Real=double >
 	class BoundingBox
 	{
-		template< unsigned int _Dim >
-		friend BoundingBox< _Dim > operator * ( const Matrix< _Dim+1 , _Dim+1 > & , const BoundingBox< _Dim > & );
+		template< unsigned int _Dim , typename _Real >
+		friend BoundingBox< _Dim , _Real > operator * ( const Matrix< _Dim+1 , _Dim+1 , _Real > & , const BoundingBox< _Dim , _Real > & );
 
 		/** The end-points of the bounding box. */
-		Point< Dim > _p[2];
+		Point< Dim , Real > _p[2];
 	public:
 		/** The default constructor */
 		BoundingBox( void );
 
 		/** This constructor creates the (minimal) bounding box containing the two points. */
-		BoundingBox( const Point< Dim > &p1 , const Point< Dim > &p2 );
+		BoundingBox( const Point< Dim , Real > &p1 , const Point< Dim , Real > &p2 );
 
 		/** This constructor generates the (minimal) bounding box that contains all of the points in the input array.*/
-		BoundingBox( const Point< Dim > *pList , int pSize );
+		BoundingBox( const Point< Dim , Real > *pList , int pSize );
+
+		/** This constructor converts a bounding box with coefficients of a different type. */
+		template< typename _Real >
+		explicit BoundingBox( const BoundingBox< Dim , _Real > &b );
 
 		/** This method returns the value of the indexed corner of the bounding box.
 		*** Valid values for index are { 0 , 1 }. */
-		Point< Dim > &operator[] ( int index );
+		Point< Dim , Real > &operator[] ( int index );
 
 		/** This method returns the value of the indexed corner of the bounding box.
 		*** Valid values for index are { 0 , 1 }. */
-		const Point< Dim > &operator[] ( int index ) const;
+		const Point< Dim , Real > &operator[] ( int index ) const;
 
 		/** This method returns the (minimal) bounding box containing the union of the two bounding boxes.
 		*** If one of the bounding boxes is empty, it is ignored. */
@@ -381,14 +431,18 @@ namespace Util
 		BoundingBox& operator ^= ( const BoundingBox &b );
 
 		/** This method returns true if a point in inside the box */
-		bool isInside( const Point< Dim > &p ) const;
+		bool isInside( const Point< Dim , Real > &p ) const;
 
 		/** This method indicates if the bounding box is empty. */
 		bool isEmpty( void ) const;
 
 		/** This method returns the span of the intersection of the box with the ray.
 		*** If the ray does not intersect the ray, it returns an empty span */
-		BoundingBox< 1 > intersect( const Ray< Dim > &ray ) const;
+		BoundingBox< 1 , Real > intersect( const Ray< Dim , Real > &ray ) const;
+
+		/** This method clips the range [tMin,tMax] to the span of the intersection of the box with the ray, returning false if the clipped range is empty.
+		*** If the ray is parallel to a slab and starts on its boundary the slab times are undefined (NaN), in which case the slab imposes no constraint. */
+		bool intersect( const ReciprocalRay< Dim , Real > &ray , Real &tMin , Real &tMax ) const;
 	};
 
 	template< unsigned int Dim > struct QuadricBoundingBoxIntersectionInfo;
@@ -508,12 +562,12 @@ namespace Util
 
 	/** This method returns the bounding box generated by first transforming the initial bounding box according to the specified transformation and then
 	* finding the minimal axis-aligned bounding box containing the transformed box. */
-	template< unsigned int Dim >
-	BoundingBox< Dim > operator * ( const Matrix< Dim+1 , Dim+1 > &m , const BoundingBox< Dim > &b );
+	template< unsigned int Dim , typename Real >
+	BoundingBox< Dim , Real > operator * ( const Matrix< Dim+1 , Dim+1 , Real > &m , const BoundingBox< Dim , Real > &b );
 
 	/** Functionality for outputing a bounding box to a stream.*/
-	template< unsigned int Dim >
-	std::ostream &operator << ( std::ostream &stream , const Point< Dim > &p );
+	template< unsigned int Dim , typename Real >
+	std::ostream &operator << ( std::ostream &stream , const BoundingBox< Dim , Real > &b );
 
 	////////////////////////////////////////////
 	// Classes specialized for 2D, 3D, and 4D //
@@ -531,8 +585,11 @@ namespace Util
 	/** A point in 4D */
 	typedef Point< 4 > Point4D;
 
+	/** A single precision point in 3D */
+	typedef Point< 3 , float > Point3F;
+
 	/** A square matrix */
-	template< unsigned int Dim > using SquareMatrix = Matrix< Dim , Dim >;
+	template< unsigned int Dim , typename Real=double > using SquareMatrix = Matrix< Dim , Dim , Real >;
 
 	/** A 1x1 matrix */
 	typedef Matrix< 1 , 1 > Matrix1D;
@@ -567,6 +624,12 @@ namespace Util
 	/** A ray in 4D */
 	typedef Ray< 4 > Ray4D;
 
+	/** A single precision ray in 3D */
+	typedef Ray< 3 , float > Ray3F;
+
+	/** A ray in 3D, prepared for intersection with boxes */
+	typedef ReciprocalRay< 3 > ReciprocalRay3D;
+
 	/** A bounding box in 1D */
 	typedef BoundingBox< 1 > BoundingBox1D;
 
@@ -579,6 +642,9 @@ namespace Util
 	/** A bounding box in 4D */
 	typedef BoundingBox< 4 > BoundingBox4D;
 
+	/** A single precision bounding box in 3D */
+	typedef BoundingBox< 3 , float > BoundingBox3F;
+
 	/** This class represents a quaternion */
 	class Quaternion : public Field< Quaternion > , public _InnerProductSpace< Quaternion >
 	{
@@ -775,6 +841,19 @@ namespace Util
 		Matrix4D operator()( void ) const;
 	};
 }
+
+namespace Util
+{
+	// The explicit specializations of the Point and Matrix kernels are defined in geometry.simd.inl, but have to be declared before any (non-template) inline definition in geometry.inl uses them
+	template<> inline Point< 3 > Point< 3 >::CrossProduct( const Point *points );
+	template<> inline double Point< 3 >::dot( const Point &q ) const;
+	template<> inline double Point< 4 >::dot( const Point &q ) const;
+	template<> inline Point< 3 > _BaseMatrix< 3 , 3 , Matrix< 3 , 3 > , Matrix< 3 , 3 > , double >::operator * ( const Point< 3 > &p ) const;
+	template<> inline Point< 4 > _BaseMatrix< 4 , 4 , Matrix< 4 , 4 > , Matrix< 4 , 4 > , double >::operator * ( const Point< 4 > &p ) const;
+	template<> template<> inline Matrix< 4 , 4 > Matrix< 4 , 4 >::operator * < 4 >( const Matrix< 4 , 4 > &m ) const;
+	template<> inline Point< 3 > Matrix< 4 , 4 >::operator * ( const Point< 3 > &p ) const;
+}
 #include "geometry.inl"
+#include "geometry.simd.inl"
 #include "geometry.todo.inl"
 #endif // GEOMETRY_INCLUDED
@@ -36,102 +36,106 @@ namespace Util
 	///////////
 	// Point //
 	///////////
-	template< unsigned int Dim >
-	void Point< Dim >::_init( const double *values , unsigned int sz )
+	template< unsigned int Dim , typename Real >
+	void Point< Dim , Real >::_init( const Real *values , unsigned int sz )
 	{
 		if     ( sz==0   ) memset( _p , 0 , sizeof(_p) );
 		else if( sz==Dim ) memcpy( _p , values , sizeof(_p) );
 		else ERROR_OUT( "Should never be called" );
 	}
 
-	template< unsigned int Dim >
-	Point< Dim >::Point( void ){ memset( _p , 0 , sizeof(_p) ); }
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real >::Point( void ){ memset( _p , 0 , sizeof(_p) ); }
 
-	template< unsigned int Dim >
-	Point< Dim >::Point( const Point &p ){ memcpy( _p , p._p , sizeof(_p) ); }
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real >::Point( const Point &p ){ memcpy( _p , p._p , sizeof(_p) ); }
 
-	template< unsigned int Dim >
+	template< unsigned int Dim , typename Real >
+	template< typename _Real >
+	Point< Dim , Real >::Point( const Point< Dim , _Real > &p ){ for( int d=0 ; d<Dim ; d++ ) _p[d] = (Real)p._p[d]; }
+
+	template< unsigned int Dim , typename Real >
 	template< typename ... Doubles >
-	Point< Dim >::Point( Doubles ... values )
+	Point< Dim , Real >::Point( Doubles ... values )
 	{
-		static_assert( sizeof...(values)==Dim || sizeof...(values)==0 , "[ERROR] Point< Dim >::Point: Invalid number of coefficients" );
-		const double _values[] = { static_cast< double >( values )... };
+		static_assert( sizeof...(values)==Dim || sizeof...(values)==0 , "[ERROR] Point< Dim , Real >::Point: Invalid number of coefficients" );
+		const Real _values[] = { static_cast< Real >( values )... };
 		_init( _values , sizeof...(values) );
 	}
 
-	template< unsigned int Dim >
-	Point< Dim > Point< Dim >::operator * ( double s ) const { Point p ; for( int i=0 ; i<Dim ; i++ ) p._p[i] = _p[i] * s ; return p; }
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real > Point< Dim , Real >::operator * ( double s ) const { Point p ; for( int i=0 ; i<Dim ; i++ ) p._p[i] = _p[i] * s ; return p; }
 
-	template< unsigned int Dim >
-	Point< Dim > Point< Dim >::operator + ( const Point &p ) const { Point q ; for( int i=0 ; i<Dim ; i++ ) q._p[i] += _p[i] + p._p[i] ; return q; }
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real > Point< Dim , Real >::operator + ( const Point &p ) const { Point q ; for( int i=0 ; i<Dim ; i++ ) q._p[i] += _p[i] + p._p[i] ; return q; }
 
-	template< unsigned int Dim >
-	double Point< Dim >::dot( const Point &q ) const
+	template< unsigned int Dim , typename Real >
+	double Point< Dim , Real >::dot( const Point &q ) const
 	{
 		double dot = 0;
 		for( int i=0 ; i<Dim ; i++ ) dot += _p[i] * q._p[i];
 		return dot;
 	}
 
-	template< unsigned int Dim >
-	double& Point< Dim >::operator[] ( int i ){ return _p[i]; }
+	template< unsigned int Dim , typename Real >
+	Real &Point< Dim , Real >::operator[] ( int i ){ return _p[i]; }
 
-	template< unsigned int Dim >
-	const double &Point< Dim >::operator[] ( int i ) const { return _p[i]; }
+	template< unsigned int Dim , typename Real >
+	const Real &Point< Dim , Real >::operator[] ( int i ) const { return _p[i]; }
 
-	template< unsigned int Dim >
-	Point< Dim >  Point< Dim >::operator * ( const Point &q ) const
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real >  Point< Dim , Real >::operator * ( const Point &q ) const
 	{
 		Point p;
 		for( int i=0 ; i<Dim ; i++ ) p[i] = _p[i]*q._p[i];
 		return p;
 	}
 
-	template< unsigned int Dim >
-	Point< Dim >  Point< Dim >::operator / ( const Point &q ) const
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real >  Point< Dim , Real >::operator / ( const Point &q ) const
 	{
 		Point p;
 		for( int i=0 ; i<Dim ; i++ ) p[i] = _p[i]/q._p[i];
 		return p;
 	}
 
-	template< unsigned int Dim >
-	Point< Dim > &Point< Dim >::operator *= ( const Point &q ){	return (*this) = (*this) * q; }
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real > &Point< Dim , Real >::operator *= ( const Point &q ){	return (*this) = (*this) * q; }
 
-	template< unsigned int Dim >
-	Point< Dim > &Point< Dim >::operator /= ( const Point &q ){	return (*this) = (*this) / q; }
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real > &Point< Dim , Real >::operator /= ( const Point &q ){	return (*this) = (*this) / q; }
 
-	template< unsigned int Dim >
+	template< unsigned int Dim , typename Real >
 	template< typename ... Points >
-	Point< Dim > Point< Dim >::CrossProduct( Points ... points )
+	Point< Dim , Real > Point< Dim , Real >::CrossProduct( Points ... points )
 	{
 		static_assert( sizeof ... ( points )==Dim-1 , "[ERROR] Number of points in cross-product must be one less than the dimension" );
-		const Point< Dim > _points[] = { points ... };
+		const Point< Dim , Real > _points[] = { points ... };
 		return CrossProduct( _points );
 	}
 
-	template< unsigned int Dim >
-	Point< Dim > Point< Dim >::CrossProduct( Point *points ){ return CrossProduct( (const Point *)points );}
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real > Point< Dim , Real >::CrossProduct( Point *points ){ return CrossProduct( (const Point *)points );}
 
-	template< unsigned int Dim >
-	Point< Dim > Point< Dim >::CrossProduct( const Point *points )
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real > Point< Dim , Real >::CrossProduct( const Point *points )
 	{
-		Matrix< Dim , Dim > M;
+		Matrix< Dim , Dim , Real > M;
 		for( int d=0 ; d<Dim ; d++ ) for( int c=0 ; c<Dim-1 ; c++ ) M(d,c) = points[c][d];
 		Point p;
 		for( int d=0 ; d<Dim ; d++ ) p[d] = ( d&1 ) ? -M.subDeterminant( d , Dim-1 ) : M.subDeterminant( d , Dim-1 );
 		return p;
 	}
 
-	template< unsigned int Dim >
-	std::ostream &operator << ( std::ostream &stream , const Point< Dim > &p )
+	template< unsigned int Dim , typename Real >
+	std::ostream &operator << ( std::ostream &stream , const Point< Dim , Real > &p )
 	{
 		for( int i=0 ; i<Dim-1 ; i++ ) stream << p[i] << " ";
 		stream << p[Dim-1];
 		return stream;
 	}
-	template< unsigned int Dim >
-	std::istream &operator >> ( std::istream &stream , Point< Dim > &p )
+	template< unsigned int Dim , typename Real >
+	std::istream &operator >> ( std::istream &stream , Point< Dim , Real > &p )
 	{
 		for( int i=0 ; i<Dim ; i++ ) stream >> p[i];
 		return stream;
@@ -140,55 +144,62 @@ namespace Util
 	/////////////////
 	// _BaseMatrix //
 	/////////////////
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	double _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType >::dot( const _BaseMatrix &m ) const
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	double _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real >::dot( const _BaseMatrix &m ) const
 	{
 		double dot = 0;
 		for( int r=0 ; r<Rows ; r++ ) for( int c=0 ; c<Cols ; c++ ) dot += operator()(r,c) * m(r,c);
 		return dot;
 	}
 
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	_BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType >::_BaseMatrix( void ){ memset( _m , 0 , sizeof(_m) ); }
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	_BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real >::_BaseMatrix( void ){ memset( _m , 0 , sizeof(_m) ); }
+
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	template< typename _MatrixType , typename _MatrixTransposeType , typename _Real >
+	_BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real >::_BaseMatrix( const _BaseMatrix< Rows , Cols , _MatrixType , _MatrixTransposeType , _Real > &m )
+	{
+		for( int r=0 ; r<Rows ; r++ ) for( int c=0 ; c<Cols ; c++ ) _m[r][c] = (Real)m(r,c);
+	}
 
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	double& _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType >::operator() ( int r , int c ) { return _m[r][c]; }
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	Real &_BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real >::operator() ( int r , int c ) { return _m[r][c]; }
 
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	const double &_BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType >::operator() ( int r , int c ) const { return _m[r][c]; }
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	const Real &_BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real >::operator() ( int r , int c ) const { return _m[r][c]; }
 
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	MatrixTransposeType _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType >::transpose( void ) const
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	MatrixTransposeType _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real >::transpose( void ) const
 	{
 		MatrixTransposeType n;
 		for( int r=0 ; r<Rows ; r++ ) for( int c=0 ; c<Cols ; c++ ) n(c,r) = operator()(r,c);
 		return n;
 	}
 
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	Point< Rows > _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType >::operator * ( const Point< Cols > &p ) const
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	Point< Rows , Real > _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real >::operator * ( const Point< Cols , Real > &p ) const
 	{
-		Point< Rows > q;
+		Point< Rows , Real > q;
 		for( int r=0 ; r<Rows ; r++ ) for( int c=0 ; c<Cols ; c++ ) q[r] += operator()(r,c) * p[c];
 		return q;
 	}
 
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	MatrixType _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType >::operator * ( double s ) const { MatrixType n ; for( int r=0 ; r<Rows ; r++ ) for( int c=0 ; c<Cols ; c++ ) n(r,c) = operator()(r,c) * s ; return n; }
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	MatrixType _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real >::operator * ( double s ) const { MatrixType n ; for( int r=0 ; r<Rows ; r++ ) for( int c=0 ; c<Cols ; c++ ) n(r,c) = operator()(r,c) * s ; return n; }
 
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	MatrixType _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType >::operator + ( const MatrixType &m ) const { MatrixType n ; for( int r=0 ; r<Rows ; r++ ) for( int c=0 ; c<Cols ; c++ ) n(r,c) = operator()(r,c) + m(r,c) ; return n; }
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	MatrixType _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real >::operator + ( const MatrixType &m ) const { MatrixType n ; for( int r=0 ; r<Rows ; r++ ) for( int c=0 ; c<Cols ; c++ ) n(r,c) = operator()(r,c) + m(r,c) ; return n; }
 
 	////////////
 	// Matrix //
 	////////////
-	template< unsigned int Rows , unsigned int Cols > Matrix< Rows , Cols >::Matrix( void ) : _BaseMatrix< Rows , Cols , Matrix< Rows , Cols > , Matrix< Cols , Rows > >() {}
+	template< unsigned int Rows , unsigned int Cols , typename Real > Matrix< Rows , Cols , Real >::Matrix( void ) : _BaseMatrix< Rows , Cols , Matrix< Rows , Cols , Real > , Matrix< Cols , Rows , Real > , Real >() {}
 
-	template< unsigned int Rows , unsigned int Cols >
+	template< unsigned int Rows , unsigned int Cols , typename Real >
 	template< unsigned int _Cols >
-	Matrix< Rows , _Cols > Matrix< Rows , Cols >::operator * ( const Matrix< Cols , _Cols > &m ) const
+	Matrix< Rows , _Cols , Real > Matrix< Rows , Cols , Real >::operator * ( const Matrix< Cols , _Cols , Real > &m ) const
 	{
-		Matrix< Rows , _Cols > n;
+		Matrix< Rows , _Cols , Real > n;
 		for( int r=0 ; r<Rows ; r++ ) for( int c=0 ; c<_Cols ; c++ ) for( int i=0 ; i<Cols ; i++ ) n(r,c) += operator()(r,i) * m(i,c);
 		return n;
 	}
@@ -196,31 +207,31 @@ namespace Util
 	//////////////////
 	// SquareMatrix //
 	//////////////////
-	template< unsigned int Dim > SquareMatrix< Dim >::Matrix( void ) : _BaseMatrix< Dim , Dim , SquareMatrix< Dim > , SquareMatrix< Dim > >() {}
-	template< unsigned int Dim >
-	SquareMatrix< Dim >::Matrix( const SquareMatrix< Dim+1 > &n ){ for( int i=0 ; i<Dim ; i++ ) for( int j=0 ; j<Dim ; j++ ) operator()(i,j) = n(i,j); }
+	template< unsigned int Dim , typename Real > SquareMatrix< Dim , Real >::Matrix( void ) : _BaseMatrix< Dim , Dim , SquareMatrix< Dim , Real > , SquareMatrix< Dim , Real > , Real >() {}
+	template< unsigned int Dim , typename Real >
+	SquareMatrix< Dim , Real >::Matrix( const SquareMatrix< Dim+1 , Real > &n ){ for( int i=0 ; i<Dim ; i++ ) for( int j=0 ; j<Dim ; j++ ) operator()(i,j) = n(i,j); }
 
-	template< unsigned int Dim >
-	SquareMatrix< Dim >::Matrix( const SquareMatrix< Dim-1 > &n , Point< Dim-1 > p ) : Matrix()
+	template< unsigned int Dim , typename Real >
+	SquareMatrix< Dim , Real >::Matrix( const SquareMatrix< Dim-1 , Real > &n , Point< Dim-1 , Real > p ) : Matrix()
 	{
 		for( int i=0 ; i<Dim-1 ; i++ ) for( int j=0 ; j<Dim-1 ; j++ ) operator()(i,j) = n(i,j);
 		operator()(Dim-1,Dim-1) = 1.;
 		for( int i=0 ; i<Dim-1 ; i++ ) operator()(i,Dim-1) = p[i];
 	}
 
-	template< unsigned int Dim >
+	template< unsigned int Dim , typename Real >
 	template< unsigned int Cols >
-	Matrix< Dim , Cols > SquareMatrix< Dim >::operator * ( const Matrix< Dim , Cols > &m ) const
+	Matrix< Dim , Cols , Real > SquareMatrix< Dim , Real >::operator * ( const Matrix< Dim , Cols , Real > &m ) const
 	{
-		Matrix< Dim , Cols > n;
+		Matrix< Dim , Cols , Real > n;
 		for( int r=0 ; r<Dim ; r++ ) for( int c=0 ; c<Cols ; c++ ) for( int i=0 ; i<Dim ; i++ ) n(r,c) += operator()(r,i) * m(i,c);
 		return n;
 	}
 
-	template< unsigned int Dim >
-	double SquareMatrix< Dim >::subDeterminant( int r , int c ) const
+	template< unsigned int Dim , typename Real >
+	double SquareMatrix< Dim , Real >::subDeterminant( int r , int c ) const
 	{
-		SquareMatrix< Dim-1 > m;
+		SquareMatrix< Dim-1 , Real > m;
 		int rr[Dim-1] , cc[Dim-1];
 		for( int a=0 , _r=0 , _c=0 ; a<Dim ; a++ )
 		{
@@ -231,119 +242,186 @@ namespace Util
 		return m.determinant();
 	}
 
-	template< unsigned int Dim >
-	double SquareMatrix< Dim >::determinant( void ) const
+	// The determinant and inverse are computed by cofactor expansion, with closed-form expressions for matrices of dimension four or less.
+	// (The overloads for the small dimensions are more specialized than the general ones, so they are preferred by overload resolution.)
+	template< unsigned int Dim , typename Real >
+	double _Determinant( const SquareMatrix< Dim , Real > &m )
 	{
 		double det = 0.;
 		for( int d=0 ; d<Dim ; d++ ) 
-			if( d&1 ) det -= operator()(0,d) * subDeterminant( 0 , d );
-			else      det += operator()(0,d) * subDeterminant( 0 , d );
+			if( d&1 ) det -= m(0,d) * m.subDeterminant( 0 , d );
+			else      det += m(0,d) * m.subDeterminant( 0 , d );
 		return det;
 	}
 
-	template<>
-	inline double SquareMatrix< 3 >::determinant( void ) const
+	// The 4 x 4 cofactors are expanded in terms of the 2 x 2 minors of the top two rows (s) and the bottom two rows (c), so that each minor is only computed once.
+	// (The minors are indexed by the pairs of columns { 01 , 02 , 03 , 12 , 13 , 23 } for s, and in the reverse order for c.)
+	template< typename Real >
+	void _Minors( const SquareMatrix< 4 , Real > &m , double s[6] , double c[6] )
 	{
-		return
-			operator()(0,0)*( operator()(1,1)*operator()(2,2) - operator()(1,2)*operator()(2,1) ) -
-			operator()(0,1)*( operator()(1,0)*operator()(2,2) - operator()(1,2)*operator()(2,0) ) +
-			operator()(0,2)*( operator()(1,0)*operator()(2,1) - operator()(1,1)*operator()(2,0) );
-	}
+		s[0] = m(0,0)*m(1,1) - m(1,0)*m(0,1);
+		s[1] = m(0,0)*m(1,2) - m(1,0)*m(0,2);
+		s[2] = m(0,0)*m(1,3) - m(1,0)*m(0,3);
+		s[3] = m(0,1)*m(1,2) - m(1,1)*m(0,2);
+		s[4] = m(0,1)*m(1,3) - m(1,1)*m(0,3);
+		s[5] = m(0,2)*m(1,3) - m(1,2)*m(0,3);
 
-	template<>
-	inline double SquareMatrix< 2 >::determinant( void ) const { return operator()(0,0)*operator()(1,1) - operator()(0,1)*operator()(1,0); }
-
-	template<>
-	inline double SquareMatrix< 1 >::determinant( void ) const { return operator()(0,0); }
+		c[5] = m(2,2)*m(3,3) - m(3,2)*m(2,3);
+		c[4] = m(2,1)*m(3,3) - m(3,1)*m(2,3);
+		c[3] = m(2,1)*m(3,2) - m(3,1)*m(2,2);
+		c[2] = m(2,0)*m(3,3) - m(3,0)*m(2,3);
+		c[1] = m(2,0)*m(3,2) - m(3,0)*m(2,2);
+		c[0] = m(2,0)*m(3,1) - m(3,0)*m(2,1);
+	}
 
-	template< unsigned int Dim >
-	double SquareMatrix< Dim >::trace( void ) const
+	template< typename Real >
+	double _Determinant( const SquareMatrix< 4 , Real > &m )
 	{
-		double tr = 0;
-		for( int i=0 ; i<Dim ; i++ ) tr += operator()(i,i);
-		return tr;
+		double s[6] , c[6];
+		_Minors( m , s , c );
+		return s[0]*c[5] - s[1]*c[4] + s[2]*c[3] + s[3]*c[2] - s[4]*c[1] + s[5]*c[0];
 	}
-	template< unsigned int Dim >
-	SquareMatrix< Dim > SquareMatrix< Dim >::inverse( void ) const
+
+	template< typename Real >
+	double _Determinant( const SquareMatrix< 3 , Real > &m )
 	{
-		Matrix inv;
-		if( !setInverse( inv ) ) THROW( " singular matrix" );
-		return inv;
+		return
+			m(0,0)*( m(1,1)*m(2,2) - m(1,2)*m(2,1) ) -
+			m(0,1)*( m(1,0)*m(2,2) - m(1,2)*m(2,0) ) +
+			m(0,2)*( m(1,0)*m(2,1) - m(1,1)*m(2,0) );
 	}
 
-	template< unsigned int Dim >
-	bool SquareMatrix< Dim >::setInverse( Matrix &inv ) const
+	template< typename Real >
+	double _Determinant( const SquareMatrix< 2 , Real > &m ){ return m(0,0)*m(1,1) - m(0,1)*m(1,0); }
+
+	template< typename Real >
+	double _Determinant( const SquareMatrix< 1 , Real > &m ){ return m(0,0); }
+
+	template< unsigned int Dim , typename Real >
+	bool _SetInverse( const SquareMatrix< Dim , Real > &m , SquareMatrix< Dim , Real > &inv )
 	{
-		double d = determinant();
+		double d = m.determinant();
 		if( !d ) return false;
 		for( int i=0 ; i<Dim ; i++ ) for( int j=0 ; j<Dim ; j++ )
-			if( (i+j)%2==0 ) inv(i,j) =  subDeterminant( j , i ) / d;
-			else             inv(i,j) = -subDeterminant( j , i ) / d;
+			if( (i+j)%2==0 ) inv(i,j) =  m.subDeterminant( j , i ) / d;
+			else             inv(i,j) = -m.subDeterminant( j , i ) / d;
+		return true;
+	}
+
+	template< typename Real >
+	bool _SetInverse( const SquareMatrix< 4 , Real > &m , SquareMatrix< 4 , Real > &inv )
+	{
+		double s[6] , c[6];
+		_Minors( m , s , c );
+		double det = s[0]*c[5] - s[1]*c[4] + s[2]*c[3] + s[3]*c[2] - s[4]*c[1] + s[5]*c[0];
+		if( !det ) return false;
+		double i = 1./det;
+		inv(0,0) = (  m(1,1)*c[5] - m(1,2)*c[4] + m(1,3)*c[3] ) * i;
+		inv(0,1) = ( -m(0,1)*c[5] + m(0,2)*c[4] - m(0,3)*c[3] ) * i;
+		inv(0,2) = (  m(3,1)*s[5] - m(3,2)*s[4] + m(3,3)*s[3] ) * i;
+		inv(0,3) = ( -m(2,1)*s[5] + m(2,2)*s[4] - m(2,3)*s[3] ) * i;
+
+		inv(1,0) = ( -m(1,0)*c[5] + m(1,2)*c[2] - m(1,3)*c[1] ) * i;
+		inv(1,1) = (  m(0,0)*c[5] - m(0,2)*c[2] + m(0,3)*c[1] ) * i;
+		inv(1,2) = ( -m(3,0)*s[5] + m(3,2)*s[2] - m(3,3)*s[1] ) * i;
+		inv(1,3) = (  m(2,0)*s[5] - m(2,2)*s[2] + m(2,3)*s[1] ) * i;
+
+		inv(2,0) = (  m(1,0)*c[4] - m(1,1)*c[2] + m(1,3)*c[0] ) * i;
+		inv(2,1) = ( -m(0,0)*c[4] + m(0,1)*c[2] - m(0,3)*c[0] ) * i;
+		inv(2,2) = (  m(3,0)*s[4] - m(3,1)*s[2] + m(3,3)*s[0] ) * i;
+		inv(2,3) = ( -m(2,0)*s[4] + m(2,1)*s[2] - m(2,3)*s[0] ) * i;
+
+		inv(3,0) = ( -m(1,0)*c[3] + m(1,1)*c[1] - m(1,2)*c[0] ) * i;
+		inv(3,1) = (  m(0,0)*c[3] - m(0,1)*c[1] + m(0,2)*c[0] ) * i;
+		inv(3,2) = ( -m(3,0)*s[3] + m(3,1)*s[1] - m(3,2)*s[0] ) * i;
+		inv(3,3) = (  m(2,0)*s[3] - m(2,1)*s[1] + m(2,2)*s[0] ) * i;
+
 		return true;
 	}
 
-	template<>
-	inline bool SquareMatrix< 3 >::setInverse( Matrix &inv ) const
+	template< typename Real >
+	bool _SetInverse( const SquareMatrix< 3 , Real > &m , SquareMatrix< 3 , Real > &inv )
 	{
-		double det = determinant();
+		double det = m.determinant();
 		if( !det ) return false;
-		inv(0,0) =  ( operator()(1,1)*operator()(2,2) - operator()(1,2)*operator()(2,1) ) / det;
-		inv(0,1) = -( operator()(0,1)*operator()(2,2) - operator()(2,1)*operator()(0,2) ) / det;
-		inv(0,2) =  ( operator()(0,1)*operator()(1,2) - operator()(0,2)*operator()(1,1) ) / det;
-		inv(1,0) = -( operator()(1,0)*operator()(2,2) - operator()(1,2)*operator()(2,0) ) / det;
-		inv(1,1) =  ( operator()(0,0)*operator()(2,2) - operator()(0,2)*operator()(2,0) ) / det;
-		inv(1,2) = -( operator()(0,0)*operator()(1,2) - operator()(0,2)*operator()(1,0) ) / det;
-		inv(2,0) =  ( operator()(1,0)*operator()(2,1) - operator()(1,1)*operator()(2,0) ) / det;
-		inv(2,1) = -( operator()(0,0)*operator()(2,1) - operator()(0,1)*operator()(2,0) ) / det;
-		inv(2,2) =  ( operator()(0,0)*operator()(1,1) - operator()(0,1)*operator()(1,0) ) / det;
+		inv(0,0) =  ( m(1,1)*m(2,2) - m(1,2)*m(2,1) ) / det;
+		inv(0,1) = -( m(0,1)*m(2,2) - m(2,1)*m(0,2) ) / det;
+		inv(0,2) =  ( m(0,1)*m(1,2) - m(0,2)*m(1,1) ) / det;
+		inv(1,0) = -( m(1,0)*m(2,2) - m(1,2)*m(2,0) ) / det;
+		inv(1,1) =  ( m(0,0)*m(2,2) - m(0,2)*m(2,0) ) / det;
+		inv(1,2) = -( m(0,0)*m(1,2) - m(0,2)*m(1,0) ) / det;
+		inv(2,0) =  ( m(1,0)*m(2,1) - m(1,1)*m(2,0) ) / det;
+		inv(2,1) = -( m(0,0)*m(2,1) - m(0,1)*m(2,0) ) / det;
+		inv(2,2) =  ( m(0,0)*m(1,1) - m(0,1)*m(1,0) ) / det;
 
 		return true;
 	}
 
-	template<>
-	inline bool SquareMatrix< 2 >::setInverse( Matrix &inv ) const
+	template< typename Real >
+	bool _SetInverse( const SquareMatrix< 2 , Real > &m , SquareMatrix< 2 , Real > &inv )
 	{
-		double det = determinant();
+		double det = m.determinant();
 		if( !det ) return false;
-		inv(0,0) =  operator()(1,1) / det;
-		inv(1,1) =  operator()(0,0) / det;
-		inv(1,0) = -operator()(1,0) / det;
-		inv(0,1) = -operator()(0,1) / det;
+		inv(0,0) =  m(1,1) / det;
+		inv(1,1) =  m(0,0) / det;
+		inv(1,0) = -m(1,0) / det;
+		inv(0,1) = -m(0,1) / det;
 
 		return true;
 	}
 
-	template<>
-	inline bool SquareMatrix< 1 >::setInverse( Matrix &inv ) const
+	template< typename Real >
+	bool _SetInverse( const SquareMatrix< 1 , Real > &m , SquareMatrix< 1 , Real > &inv )
 	{
-		double det = operator()(0,0);
+		double det = m(0,0);
 		if( !det ) return false;
 		inv(0,0) = 1./det;
 		return true;
 	}
 
-	template< unsigned int Dim >
-	Point< Dim-1 > SquareMatrix< Dim >::operator * ( const Point< Dim-1 > &p ) const
+	template< unsigned int Dim , typename Real >
+	double SquareMatrix< Dim , Real >::determinant( void ) const { return _Determinant( *this ); }
+
+	template< unsigned int Dim , typename Real >
+	double SquareMatrix< Dim , Real >::trace( void ) const
 	{
-		Point< Dim > q;
+		double tr = 0;
+		for( int i=0 ; i<Dim ; i++ ) tr += operator()(i,i);
+		return tr;
+	}
+	template< unsigned int Dim , typename Real >
+	SquareMatrix< Dim , Real > SquareMatrix< Dim , Real >::inverse( void ) const
+	{
+		Matrix inv;
+		if( !setInverse( inv ) ) THROW( " singular matrix" );
+		return inv;
+	}
+
+	template< unsigned int Dim , typename Real >
+	bool SquareMatrix< Dim , Real >::setInverse( Matrix &inv ) const { return _SetInverse( *this , inv ); }
+
+	template< unsigned int Dim , typename Real >
+	Point< Dim-1 , Real > SquareMatrix< Dim , Real >::operator * ( const Point< Dim-1 , Real > &p ) const
+	{
+		Point< Dim , Real > q;
 		for( int i=0 ; i<Dim-1 ; i++ ) q[i] = p[i];
 		q[Dim-1] = 1;
 		q = (*this) * q;
-		Point< Dim-1 > _q;
+		Point< Dim-1 , Real > _q;
 		for( int i=0 ; i<Dim-1 ; i++ ) _q[i] = q[i] / q[Dim-1];
 		return _q;
 	}
 
-	template< unsigned int Dim >
-	SquareMatrix< Dim > SquareMatrix< Dim >::Identity( void )
+	template< unsigned int Dim , typename Real >
+	SquareMatrix< Dim , Real > SquareMatrix< Dim , Real >::Identity( void )
 	{
 		Matrix m;
 		for( int i=0 ; i<Dim ; i++ ) m(i,i) = 1;
 		return m;
 	}
 
-	template< unsigned int Dim >
-	void SquareMatrix< Dim >::SVD( Matrix& r1 , Matrix& d , Matrix& r2 ) const
+	template< unsigned int Dim , typename Real >
+	void SquareMatrix< Dim , Real >::SVD( Matrix& r1 , Matrix& d , Matrix& r2 ) const
 	{
 		GXMatrixMNd M( Dim , Dim );
 		GXMatrixMNd U, W, Vt;
@@ -362,8 +440,8 @@ namespace Util
 	// Code borrowed from:
 	// Linear Combination of Transformations
 	// Marc Alexa
-	template< unsigned int Dim >
-	SquareMatrix< Dim > SquareMatrix< Dim >::SquareRoot( const Matrix& m , double eps )
+	template< unsigned int Dim , typename Real >
+	SquareMatrix< Dim , Real > SquareMatrix< Dim , Real >::SquareRoot( const Matrix& m , double eps )
 	{
 		Matrix X,Y;
 		X = m;
@@ -378,8 +456,8 @@ namespace Util
 		return X;
 	}
 
-	template< unsigned int Dim >
-	SquareMatrix< Dim > SquareMatrix< Dim >::Log( const Matrix& m , double eps )
+	template< unsigned int Dim , typename Real >
+	SquareMatrix< Dim , Real > SquareMatrix< Dim , Real >::Log( const Matrix& m , double eps )
 	{
 		Matrix I = Identity();
 		Matrix X , Z , A=m;
@@ -401,14 +479,14 @@ namespace Util
 		return X * ( -pow( 2.0 , (double)k ) );
 	}
 
-	template< unsigned int Dim >
-	SquareMatrix< Dim > SquareMatrix< Dim >::symmetrize( void ) const { return ( (*this)+transpose() ) / 2; }
+	template< unsigned int Dim , typename Real >
+	SquareMatrix< Dim , Real > SquareMatrix< Dim , Real >::symmetrize( void ) const { return ( (*this)+transpose() ) / 2; }
 
-	template< unsigned int Dim >
-	SquareMatrix< Dim > SquareMatrix< Dim >::skewSymmetrize( void ) const { return ( (*this)-transpose() ) / 2; }
+	template< unsigned int Dim , typename Real >
+	SquareMatrix< Dim , Real > SquareMatrix< Dim , Real >::skewSymmetrize( void ) const { return ( (*this)-transpose() ) / 2; }
 
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	std::ostream &operator << ( std::ostream &stream , const _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType > &m )
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	std::ostream &operator << ( std::ostream &stream , const _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real > &m )
 	{
 		for( unsigned int c=0 ; c<Cols ; c++ ) for( unsigned int r=0 ; r<Rows ; r++ )
 		{
@@ -418,8 +496,8 @@ namespace Util
 		return stream;
 	}
 
-	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType >
-	std::istream &operator >> ( std::istream &stream , _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType > &m )
+	template< unsigned int Rows , unsigned int Cols , typename MatrixType , typename MatrixTransposeType , typename Real >
+	std::istream &operator >> ( std::istream &stream , _BaseMatrix< Rows , Cols , MatrixType , MatrixTransposeType , Real > &m )
 	{
 		for( unsigned int c=0 ; c<Cols ; c++ ) for( unsigned int r=0 ; r<Rows ; r++ ) stream >> m(r,c); 
 		return stream;
@@ -468,67 +546,88 @@ namespace Util
 	/////////
 	// Ray //
 	/////////
-	template< unsigned int Dim >
-	Ray< Dim >::Ray( void ){}
+	template< unsigned int Dim , typename Real >
+	Ray< Dim , Real >::Ray( void ){}
 
-	template< unsigned int Dim >
-	Ray< Dim >::Ray( const Point< Dim > &p , const Point< Dim > &d ) : position(p) , direction(d) {}
+	template< unsigned int Dim , typename Real >
+	Ray< Dim , Real >::Ray( const Point< Dim , Real > &p , const Point< Dim , Real > &d ) : position(p) , direction(d) {}
 
-	template< unsigned int Dim >
-	Point< Dim > Ray< Dim >::operator() ( double s ) const { return position+direction*s; }
+	template< unsigned int Dim , typename Real >
+	template< typename _Real >
+	Ray< Dim , Real >::Ray( const Ray< Dim , _Real > &ray ) : position( ray.position ) , direction( ray.direction ) {}
 
-	template< unsigned int Dim >
-	Ray< Dim >  Ray< Dim >::operator +  ( const Point< Dim > &p ) const { return Ray( position+p , direction );}
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real > Ray< Dim , Real >::operator() ( Real s ) const { return position+direction*s; }
 
-	template< unsigned int Dim >
-	Ray< Dim > &Ray< Dim >::operator += ( const Point< Dim > &p ){ position += p ; return *this; }
+	template< unsigned int Dim , typename Real >
+	Ray< Dim , Real >  Ray< Dim , Real >::operator +  ( const Point< Dim , Real > &p ) const { return Ray( position+p , direction );}
 
-	template< unsigned int Dim >
-	Ray< Dim >  Ray< Dim >::operator -  ( const Point< Dim > &p ) const { return Ray( position-p , direction );}
+	template< unsigned int Dim , typename Real >
+	Ray< Dim , Real > &Ray< Dim , Real >::operator += ( const Point< Dim , Real > &p ){ position += p ; return *this; }
 
-	template< unsigned int Dim >
-	Ray< Dim > &Ray< Dim >::operator -= ( const Point< Dim > &p ){ position -= p ; return *this; }
+	template< unsigned int Dim , typename Real >
+	Ray< Dim , Real >  Ray< Dim , Real >::operator -  ( const Point< Dim , Real > &p ) const { return Ray( position-p , direction );}
 
-	template< unsigned int Dim >
-	Ray< Dim > operator * ( const Matrix< Dim+1 , Dim+1 > &m , const Ray< Dim >& r )
+	template< unsigned int Dim , typename Real >
+	Ray< Dim , Real > &Ray< Dim , Real >::operator -= ( const Point< Dim , Real > &p ){ position -= p ; return *this; }
+
+	template< unsigned int Dim , typename Real >
+	Ray< Dim , Real > operator * ( const Matrix< Dim+1 , Dim+1 , Real > &m , const Ray< Dim , Real >& r )
 	{
-		return Ray< Dim >( m * r.position , Matrix< Dim , Dim >(m) * r.direction );
+		return Ray< Dim , Real >( m * r.position , Matrix< Dim , Dim , Real >(m) * r.direction );
 	}
 
 
+	///////////////////
+	// ReciprocalRay //
+	///////////////////
+	template< unsigned int Dim , typename Real >
+	ReciprocalRay< Dim , Real >::ReciprocalRay( void ){ for( int d=0 ; d<Dim ; d++ ) sign[d] = 0; }
+
+	template< unsigned int Dim , typename Real >
+	ReciprocalRay< Dim , Real >::ReciprocalRay( const Ray< Dim , Real > &ray ) : position( ray.position )
+	{
+		// A zero coefficient (of either sign) gives an infinite reciprocal of the same sign, so the sign is read off the reciprocal
+		for( int d=0 ; d<Dim ; d++ ) inverseDirection[d] = (Real)1 / ray.direction[d] , sign[d] = inverseDirection[d]<0 ? 1 : 0;
+	}
+
 	/////////////////
 	// BoundingBox //
 	/////////////////
-	template< unsigned int Dim >
-	BoundingBox< Dim >::BoundingBox( void ){}
+	template< unsigned int Dim , typename Real >
+	BoundingBox< Dim , Real >::BoundingBox( void ){}
 
-	template< unsigned int Dim >
-	BoundingBox< Dim >::BoundingBox( const Point< Dim > &p1 , const Point< Dim > &p2 )
+	template< unsigned int Dim , typename Real >
+	BoundingBox< Dim , Real >::BoundingBox( const Point< Dim , Real > &p1 , const Point< Dim , Real > &p2 )
 	{
-		for( int d=0 ; d<Dim ; d++ ) _p[0][d] = std::min< double >( p1[d] , p2[d] ) , _p[1][d] = std::max< double >( p1[d] , p2[d] );
+		for( int d=0 ; d<Dim ; d++ ) _p[0][d] = std::min< Real >( p1[d] , p2[d] ) , _p[1][d] = std::max< Real >( p1[d] , p2[d] );
 	}
 
-	template< unsigned int Dim >
-	BoundingBox< Dim >::BoundingBox( const Point< Dim > *pList , int pSize )
+	template< unsigned int Dim , typename Real >
+	BoundingBox< Dim , Real >::BoundingBox( const Point< Dim , Real > *pList , int pSize )
 	{
 		if( pSize>0 )
 		{
 			_p[0] = _p[1] = pList[0];
-			for( int i=1 ; i<pSize ; i++ ) for( int j=0 ; j<Dim ; j++ ) _p[0][j] = std::min< double >( _p[0][j] , pList[i][j] ) , _p[1][j] = std::max< double >( _p[1][j] , pList[i][j] );
+			for( int i=1 ; i<pSize ; i++ ) for( int j=0 ; j<Dim ; j++ ) _p[0][j] = std::min< Real >( _p[0][j] , pList[i][j] ) , _p[1][j] = std::max< Real >( _p[1][j] , pList[i][j] );
 		}
 	}
 
-	template< unsigned int Dim >
-	Point< Dim > &BoundingBox< Dim >::operator[] ( int idx ){ return _p[idx]; }
+	template< unsigned int Dim , typename Real >
+	template< typename _Real >
+	BoundingBox< Dim , Real >::BoundingBox( const BoundingBox< Dim , _Real > &b ){ _p[0] = Point< Dim , Real >( b[0] ) , _p[1] = Point< Dim , Real >( b[1] ); }
 
-	template< unsigned int Dim >
-	const Point< Dim > &BoundingBox< Dim >::operator[] ( int idx ) const { return _p[idx]; }
+	template< unsigned int Dim , typename Real >
+	Point< Dim , Real > &BoundingBox< Dim , Real >::operator[] ( int idx ){ return _p[idx]; }
 
-	template< unsigned int Dim >
-	BoundingBox< Dim > BoundingBox< Dim >::operator + ( const BoundingBox &b ) const
+	template< unsigned int Dim , typename Real >
+	const Point< Dim , Real > &BoundingBox< Dim , Real >::operator[] ( int idx ) const { return _p[idx]; }
+
+	template< unsigned int Dim , typename Real >
+	BoundingBox< Dim , Real > BoundingBox< Dim , Real >::operator + ( const BoundingBox &b ) const
 	{
-		Point< Dim > pList[4];
-		Point< Dim > q;
+		Point< Dim , Real > pList[4];
+		Point< Dim , Real > q;
 
 		if( b.isEmpty() ) return *this;
 		if(   isEmpty() ) return b;
@@ -539,52 +638,66 @@ namespace Util
 		return BoundingBox( pList , 4 );
 	}
 
-	template< unsigned int Dim >
-	BoundingBox< Dim > &BoundingBox< Dim >::operator += ( const BoundingBox &b ){ return (*this) = (*this) + b; }
+	template< unsigned int Dim , typename Real >
+	BoundingBox< Dim , Real > &BoundingBox< Dim , Real >::operator += ( const BoundingBox &b ){ return (*this) = (*this) + b; }
 
-	template< unsigned int Dim >
-	BoundingBox< Dim > BoundingBox< Dim >::operator ^ ( const BoundingBox &b ) const
+	template< unsigned int Dim , typename Real >
+	BoundingBox< Dim , Real > BoundingBox< Dim , Real >::operator ^ ( const BoundingBox &b ) const
 	{
 
 		if( isEmpty() || b.isEmpty() ) return BoundingBox();
 		BoundingBox _b;
-		for( int j=0 ; j<Dim ; j++ ) _b._p[0][j] = std::max< double >( _p[0][j] , b._p[0][j] ) , _b._p[1][j] = std::min< double >( _p[1][j] , b._p[1][j] );
+		for( int j=0 ; j<Dim ; j++ ) _b._p[0][j] = std::max< Real >( _p[0][j] , b._p[0][j] ) , _b._p[1][j] = std::min< Real >( _p[1][j] , b._p[1][j] );
 		if( _b.isEmpty() ) _b._p[0] = _b._p[1] = ( _b._p[0] + _b._p[1] ) / 2;
 		return _b;
 	}
 
-	template< unsigned int Dim >
-	BoundingBox< Dim > &BoundingBox< Dim >::operator ^= ( const BoundingBox &b ){ return (*this) = (*this) ^ b; }
+	template< unsigned int Dim , typename Real >
+	BoundingBox< Dim , Real > &BoundingBox< Dim , Real >::operator ^= ( const BoundingBox &b ){ return (*this) = (*this) ^ b; }
 
-	template< unsigned int Dim >
-	BoundingBox< Dim > operator * ( const Matrix< Dim+1 , Dim+1 > &m , const BoundingBox< Dim > &b )
+	template< unsigned int Dim , typename Real >
+	BoundingBox< Dim , Real > operator * ( const Matrix< Dim+1 , Dim+1 , Real > &m , const BoundingBox< Dim , Real > &b )
 	{
-		Point< Dim > v[1<<Dim];
+		Point< Dim , Real > v[1<<Dim];
 		for( int idx=0 ; idx<(1<<Dim) ; idx++ )
 		{
-			Point< Dim > p;
+			Point< Dim , Real > p;
 			for( int d=0 ; d<Dim ; d++ ) p[d] = b[(idx>>d)&1][d];
 			v[idx] = m * p;
 		}
-		return BoundingBox< Dim >( v , 1<<Dim );
+		return BoundingBox< Dim , Real >( v , 1<<Dim );
 	}
 
-	template< unsigned int Dim >
-	bool BoundingBox< Dim >::isInside( const Point< Dim > &p ) const
+	template< unsigned int Dim , typename Real >
+	bool BoundingBox< Dim , Real >::isInside( const Point< Dim , Real > &p ) const
 	{
 		for( int d=0 ; d<Dim ; d++ ) if( p[d]<=_p[0][d] || p[d]>=_p[1][d] ) return false;
 		return true;
 	}
 
-	template< unsigned int Dim >
-	bool BoundingBox< Dim >::isEmpty( void ) const
+	template< unsigned int Dim , typename Real >
+	bool BoundingBox< Dim , Real >::intersect( const ReciprocalRay< Dim , Real > &ray , Real &tMin , Real &tMax ) const
+	{
+		for( int d=0 ; d<Dim ; d++ )
+		{
+			Real t0 = ( _p[ ray.sign[d] ][d] - ray.position[d] ) * ray.inverseDirection[d];
+			Real t1 = ( _p[ 1-ray.sign[d] ][d] - ray.position[d] ) * ray.inverseDirection[d];
+			// The comparisons are false for NaN times, so an undefined slab leaves the range unchanged (and the selections compile to min/max instructions)
+			tMin = t0>tMin ? t0 : tMin;
+			tMax = t1<tMax ? t1 : tMax;
+		}
+		return tMin<=tMax;
+	}
+
+	template< unsigned int Dim , typename Real >
+	bool BoundingBox< Dim , Real >::isEmpty( void ) const
 	{
 		for( int d=0 ; d<Dim ; d++ ) if( _p[0][d]>=_p[1][d] ) return true;
 		return false;
 	}
 
-	template< unsigned int Dim >
-	std::ostream &operator << ( std::ostream &stream , const BoundingBox< Dim > &b )
+	template< unsigned int Dim , typename Real >
+	std::ostream &operator << ( std::ostream &stream , const BoundingBox< Dim , Real > &b )
 	{
 		stream << "[ " << b[0] << " ] [ " << b[1] << " ]";
 		return stream;
@@ -792,6 +905,26 @@ namespace Util
 		return extremum[0]>bBox[0][0] && extremum[0]<bBox[1][0] && Q(extremum)<0;
 	}
 
+	////////////////
+	// Quaternion //
+	////////////////
+	// The vector-space operations are defined inline so that compound expressions (e.g. interpolating key-frames) can be fused by the compiler without materializing the intermediate quaternions.
+	inline Quaternion::Quaternion( double r , Point3D i ) : real(r) , imag(i) {}
+
+	inline Quaternion Quaternion::additiveInverse( void ) const { return Quaternion( -real , -imag ); }
+
+	inline Quaternion Quaternion::multiplicativeInverse( void ) const { return conjugate() * ( 1./squareNorm() ); }
+
+	inline double Quaternion::dot( const Quaternion &q ) const { return real*q.real + Point3D::Dot( imag , q.imag ); }
+
+	inline Quaternion Quaternion::operator * ( double scale ) const { return Quaternion( real*scale , imag*scale ); }
+
+	inline Quaternion Quaternion::operator + ( const Quaternion &q ) const { return Quaternion( real+q.real , imag + q.imag ); }
+
+	inline Quaternion Quaternion::operator * ( const Quaternion &q ) const { return Quaternion( real*q.real - Point3D::Dot( imag , q.imag ) , imag*q.real + q.imag*real + Point3D::CrossProduct( imag , q.imag ) ); }
+
+	inline Quaternion Quaternion::conjugate( void ) const { return Quaternion( real , -imag ); }
+
 	///////////////////////
 	// RotationParameter //
 	///////////////////////
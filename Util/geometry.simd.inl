@@ -0,0 +1,124 @@
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP>=2 )
+#define GEOMETRY_SSE2
+#include <emmintrin.h>
+#if defined( __AVX__ )
+#define GEOMETRY_AVX
+#include <immintrin.h>
+#endif // __AVX__
+#endif // __SSE2__ || _M_X64 || _M_IX86_FP>=2
+
+// Specializations of the Point and Matrix kernels used by the ray-tracer for three and four dimensions.
+// The instruction set is chosen at compile time: SSE2 (two doubles per register) is part of the x86-64 baseline,
+// and the 4 x 4 matrix kernels use AVX (four doubles per register) when the code is compiled with AVX enabled (e.g. -mavx).
+// Even-dimensional points and matrices with an even number of columns are 16-byte aligned, so their (pairs of) coefficients can be loaded with aligned loads.
+// The specializations are declared in geometry.h, ahead of the inline definitions that use them.
+namespace Util
+{
+	///////////
+	// Point //
+	///////////
+	template<>
+	inline Point< 3 > Point< 3 >::CrossProduct( const Point *points )
+	{
+		const double *p = points[0]._p , *q = points[1]._p;
+		return Point( p[1]*q[2] - p[2]*q[1] , p[2]*q[0] - p[0]*q[2] , p[0]*q[1] - p[1]*q[0] );
+	}
+
+#ifdef GEOMETRY_SSE2
+	template<>
+	inline double Point< 3 >::dot( const Point &q ) const
+	{
+		__m128d d = _mm_mul_pd( _mm_loadu_pd( _p ) , _mm_loadu_pd( q._p ) );
+		d = _mm_add_sd( d , _mm_unpackhi_pd( d , d ) );
+		return _mm_cvtsd_f64( d ) + _p[2]*q._p[2];
+	}
+
+	template<>
+	inline double Point< 4 >::dot( const Point &q ) const
+	{
+		__m128d d = _mm_add_pd( _mm_mul_pd( _mm_load_pd( _p ) , _mm_load_pd( q._p ) ) , _mm_mul_pd( _mm_load_pd( _p+2 ) , _mm_load_pd( q._p+2 ) ) );
+		return _mm_cvtsd_f64( _mm_add_sd( d , _mm_unpackhi_pd( d , d ) ) );
+	}
+
+	/////////////////
+	// _BaseMatrix //
+	/////////////////
+	template<>
+	inline Point< 3 > _BaseMatrix< 3 , 3 , Matrix< 3 , 3 > , Matrix< 3 , 3 > , double >::operator * ( const Point< 3 > &p ) const
+	{
+		// The first two coefficients are computed together: the products of the first two columns are summed across each row by interleaving the rows
+		__m128d p01 = _mm_loadu_pd( &p[0] ) , p2 = _mm_set1_pd( p[2] );
+		__m128d r0 = _mm_mul_pd( _mm_loadu_pd( _m[0] ) , p01 ) , r1 = _mm_mul_pd( _mm_loadu_pd( _m[1] ) , p01 );
+		__m128d q01 = _mm_add_pd( _mm_add_pd( _mm_unpacklo_pd( r0 , r1 ) , _mm_unpackhi_pd( r0 , r1 ) ) , _mm_mul_pd( _mm_set_pd( _m[1][2] , _m[0][2] ) , p2 ) );
+		Point< 3 > q;
+		_mm_storeu_pd( &q[0] , q01 );
+		q[2] = _m[2][0]*p[0] + _m[2][1]*p[1] + _m[2][2]*p[2];
+		return q;
+	}
+
+	template<>
+	inline Point< 4 > _BaseMatrix< 4 , 4 , Matrix< 4 , 4 > , Matrix< 4 , 4 > , double >::operator * ( const Point< 4 > &p ) const
+	{
+		__m128d p01 = _mm_load_pd( &p[0] ) , p23 = _mm_load_pd( &p[2] );
+		Point< 4 > q;
+		for( int r=0 ; r<4 ; r+=2 )
+		{
+			// Sum the products across rows r and r+1, interleaving the rows so that no horizontal addition is needed
+			__m128d s0 = _mm_add_pd( _mm_mul_pd( _mm_load_pd( _m[r  ] ) , p01 ) , _mm_mul_pd( _mm_load_pd( _m[r  ]+2 ) , p23 ) );
+			__m128d s1 = _mm_add_pd( _mm_mul_pd( _mm_load_pd( _m[r+1] ) , p01 ) , _mm_mul_pd( _mm_load_pd( _m[r+1]+2 ) , p23 ) );
+			_mm_store_pd( &q[r] , _mm_add_pd( _mm_unpacklo_pd( s0 , s1 ) , _mm_unpackhi_pd( s0 , s1 ) ) );
+		}
+		return q;
+	}
+
+	//////////////////
+	// SquareMatrix //
+	//////////////////
+	template<>
+	template<>
+	inline Matrix< 4 , 4 > Matrix< 4 , 4 >::operator * < 4 >( const Matrix< 4 , 4 > &m ) const
+	{
+		// Each row of the product is the combination of the rows of m, weighted by the entries of the row of this matrix
+		Matrix< 4 , 4 > n;
+		const double *a = &operator()(0,0) , *b = &m(0,0);
+		double *c = &n(0,0);
+#ifdef GEOMETRY_AVX
+		__m256d b0 = _mm256_loadu_pd( b ) , b1 = _mm256_loadu_pd( b+4 ) , b2 = _mm256_loadu_pd( b+8 ) , b3 = _mm256_loadu_pd( b+12 );
+		for( int r=0 ; r<4 ; r++ )
+		{
+			const double *ar = a + 4*r;
+			__m256d s = _mm256_add_pd( _mm256_mul_pd( _mm256_set1_pd( ar[0] ) , b0 ) , _mm256_mul_pd( _mm256_set1_pd( ar[1] ) , b1 ) );
+			s = _mm256_add_pd( s , _mm256_add_pd( _mm256_mul_pd( _mm256_set1_pd( ar[2] ) , b2 ) , _mm256_mul_pd( _mm256_set1_pd( ar[3] ) , b3 ) ) );
+			_mm256_storeu_pd( c + 4*r , s );
+		}
+#else // !GEOMETRY_AVX
+		for( int r=0 ; r<4 ; r++ )
+		{
+			const double *ar = a + 4*r;
+			__m128d lo = _mm_setzero_pd() , hi = _mm_setzero_pd();
+			for( int i=0 ; i<4 ; i++ )
+			{
+				__m128d s = _mm_set1_pd( ar[i] );
+				lo = _mm_add_pd( lo , _mm_mul_pd( s , _mm_load_pd( b + 4*i ) ) );
+				hi = _mm_add_pd( hi , _mm_mul_pd( s , _mm_load_pd( b + 4*i + 2 ) ) );
+			}
+			_mm_store_pd( c + 4*r , lo );
+			_mm_store_pd( c + 4*r + 2 , hi );
+		}
+#endif // GEOMETRY_AVX
+		return n;
+	}
+
+	template<>
+	inline Point< 3 > Matrix< 4 , 4 >::operator * ( const Point< 3 > &p ) const
+	{
+		// Transform the homogeneous point ( p , 1 ) and divide by the homogeneous coordinate
+		Point< 4 > q = _BaseMatrix< 4 , 4 , Matrix< 4 , 4 > , Matrix< 4 , 4 > , double >::operator * ( Point< 4 >( p[0] , p[1] , p[2] , 1. ) );
+		__m128d w = _mm_set1_pd( q[3] );
+		Point< 3 > _q;
+		_mm_storeu_pd( &_q[0] , _mm_div_pd( _mm_load_pd( &q[0] ) , w ) );
+		_q[2] = q[2] / q[3];
+		return _q;
+	}
+#endif // GEOMETRY_SSE2
+}
@@ -31,8 +31,8 @@ namespace Util
 	////////////
 	// Matrix //
 	////////////
-	template< unsigned int Dim >
-	Matrix< Dim , Dim > Matrix< Dim , Dim >::Exp( const Matrix &m , int terms )
+	template< unsigned int Dim , typename Real >
+	Matrix< Dim , Dim , Real > Matrix< Dim , Dim , Real >::Exp( const Matrix &m , int terms )
 	{
 		//////////////////////////////////////
 		// Compute the matrix exponent here //
@@ -41,8 +41,8 @@ namespace Util
 		return Matrix();
 	}
 
-	template< unsigned int Dim >
-	Matrix< Dim , Dim > Matrix< Dim , Dim >::closestRotation( void ) const
+	template< unsigned int Dim , typename Real >
+	Matrix< Dim , Dim , Real > Matrix< Dim , Dim , Real >::closestRotation( void ) const
 	{
 		///////////////////////////////////////
 		// Compute the closest rotation here //
@@ -54,14 +54,14 @@ namespace Util
 	/////////////////
 	// BoundingBox //
 	/////////////////
-	template< unsigned int Dim >
-	BoundingBox< 1 > BoundingBox< Dim >::intersect( const Ray< Dim > &ray ) const
+	template< unsigned int Dim , typename Real >
+	BoundingBox< 1 , Real > BoundingBox< Dim , Real >::intersect( const Ray< Dim , Real > &ray ) const
 	{
 		///////////////////////////////////////////////////////////////
 		// Compute the intersection of a BoundingBox with a Ray here //
 		///////////////////////////////////////////////////////////////
 		WARN_ONCE( "method undefined" );
-		return BoundingBox<1>();
+		return BoundingBox< 1 , Real >();
 	}
 
 	/////////////
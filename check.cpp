@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <math.h>
+#include <new>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <Ray/scene.h>
+#include <Ray/shapeList.h>
+#include <Ray/scratchArena.h>
+#include <Ray/sphere.h>
+#include <Ray/triangle.h>
+#include <Ray/pointLight.h>
+#include <Util/exceptions.h>
+#include <Util/factory.h>
+
+using namespace std;
+using namespace Ray;
+using namespace Util;
+
+// The number of heap allocations made by the program, counted by the replacement of the global allocation functions
+static size_t AllocationNum = 0;
+
+void *operator new( size_t size )
+{
+	AllocationNum++;
+	void *memory = malloc( size ? size : 1 );
+	if( !memory ) throw std::bad_alloc();
+	return memory;
+}
+void operator delete( void *memory ) noexcept { free( memory ); }
+void operator delete( void *memory , size_t ) noexcept { free( memory ); }
+
+/** This class represents an axis-aligned box whose first intersection with a ray is its entry point, so that the checks do not depend on the assignment's shapes. */
+class CheckBox : public Shape
+{
+	void _write( std::ostream &stream ) const {}
+	void _read( std::istream &stream ) {}
+public:
+	CheckBox( BoundingBox3D bBox ){ _bBox = bBox , _primitiveNum = 1; }
+	std::string name( void ) const { return "check box"; }
+	void init( const LocalSceneData & ){}
+	void initOpenGL( void ){}
+	void updateBoundingBox( void ){}
+	bool processFirstIntersection( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+	{
+		double tMin = range[0][0] , tMax = range[1][0];
+		if( !_bBox.intersect( ReciprocalRay3D( ray ) , tMin , tMax , tIdx ) || !rFilter( tMin ) ) return false;
+		RayShapeIntersectionInfo iInfo;
+		iInfo.t = tMin , iInfo.position = ray( tMin );
+		rKernel( spInfo , iInfo );
+		return true;
+	}
+	int processAllIntersections( const Ray3D &ray , const BoundingBox1D &range , const RayIntersectionFilter &rFilter , const RayIntersectionKernel &rKernel , ShapeProcessingInfo spInfo , unsigned int tIdx ) const
+	{
+		return processFirstIntersection( ray , range , rFilter , rKernel , spInfo , tIdx ) ? 1 : 0;
+	}
+	bool isInside( Point3D p ) const { return _bBox.isInside( p ); }
+	void drawOpenGL( GLSLProgram * ) const {}
+};
+
+/** Once the thread's scratch memory has grown to its working size, tracing a ray through a list of shapes should not allocate. */
+bool CheckRayAllocations( void )
+{
+	std::vector< CheckBox > boxes;
+	ShapeList shapeList;
+	for( int i=0 ; i<64 ; i++ ) boxes.push_back( CheckBox( BoundingBox3D( Point3D( i , -1. , -1. ) , Point3D( i+0.5 , 1. , 1. ) ) ) );
+	for( unsigned int i=0 ; i<boxes.size() ; i++ ) shapeList.shapes.push_back( &boxes[i] );
+
+	std::vector< ScratchArena > arenas( 1 );
+	ScratchArena::Binding binding( arenas );
+	RayTracingStats::Reserve( 1 );
+
+	unsigned int hits = 0;
+	auto rFilter = []( double ){ return true; };
+	auto rKernel = [&]( const Shape::ShapeProcessingInfo & , const RayShapeIntersectionInfo & ){ hits++ ; return true; };
+	auto Trace = [&]( int i )
+	{
+		Ray3D ray( Point3D( -1. , 0.5*sin(i) , 0.5*cos(i) ) , Point3D( 1. , 0. , 0. ) );
+		shapeList.processFirstIntersection( ray , BoundingBox1D( Point1D( 0. ) , Point1D( Infinity ) ) , rFilter , rKernel , Shape::ShapeProcessingInfo() , 0 );
+	};
+
+	Trace( 0 );
+	size_t allocationNum = AllocationNum;
+	for( int i=1 ; i<1000 ; i++ ) Trace( i );
+	shapeList.shapes.clear();
+
+	if( hits!=1000 ) WARN( "expected 1000 hits: " , hits );
+	if( AllocationNum!=allocationNum ) WARN( "rays allocated: " , AllocationNum-allocationNum );
+	return hits==1000 && AllocationNum==allocationNum && arenas[0].blockNum()==1;
+}
+
+/** Reading a checkpoint back should give the colors that were written (to single precision), and a checkpoint for a different grid or resolution should be ignored. */
+bool CheckCheckpointRoundTrip( void )
+{
+	const int width = 7 , height = 5;
+	const unsigned int grid = 3 , passes = 4;
+	const std::string fileName = "check.checkpoint";
+	std::vector< Point3D > colors( width*height );
+	for( size_t i=0 ; i<colors.size() ; i++ ) colors[i] = Point3D( (double)rand()/RAND_MAX , (double)rand()/RAND_MAX , (double)rand()/RAND_MAX ) * passes;
+	Scene::WriteCheckpoint( fileName , width , height , grid , colors , passes );
+
+	bool success = true;
+	std::vector< Point3D > _colors( width*height );
+	unsigned int _passes = 0;
+	if( !Scene::ReadCheckpoint( fileName , width , height , grid , _colors , _passes ) || _passes!=passes ) success = false;
+	else for( size_t i=0 ; i<colors.size() ; i++ ) for( int c=0 ; c<3 ; c++ ) if( fabs( colors[i][c]-_colors[i][c] )>1e-6*passes ) success = false;
+	if( Scene::ReadCheckpoint( fileName , width , height , grid+1 , _colors , _passes ) || Scene::ReadCheckpoint( fileName , width+1 , height , grid , _colors , _passes ) ) success = false;
+
+	// An empty image should round-trip as well
+	std::vector< Point3D > empty;
+	Scene::WriteCheckpoint( fileName , 0 , 0 , grid , empty , passes );
+	if( !Scene::ReadCheckpoint( fileName , 0 , 0 , grid , empty , _passes ) || _passes!=passes ) success = false;
+
+	remove( fileName.c_str() );
+	return success;
+}
+
+/** A scene read back from its cache should write out the same text as the scene parsed from the .ray file, and a cache of a different version or that fails part-way should be ignored in favor of the text. */
+bool CheckSceneCacheRoundTrip( void )
+{
+	const std::string fileName = "check.ray" , cacheFileName = fileName + std::string( ".cache" );
+	{
+		ofstream stream( fileName );
+		stream << "#camera 0 0 5  0 0 -1  0 1 0  0.5" << endl;
+		stream << "#light_point 1 1 1  1 1 1  1 1 1  0.123456789 2 3  1 0 0" << endl;
+		stream << "#material 0.1 0.2 0.3  0.4 0.5 0.6  0.7 0.8 0.9  0.1 0.1 0.1  10  0 0 0  1.5  -1 !foo!" << endl;
+		stream << "#vertex 0.1 0 0  0 0 1  0 0" << endl;
+		stream << "#vertex 1 0 0  0 0 1  1 0" << endl;
+		stream << "#vertex 0 1 0  0 0 1  0 1" << endl;
+		stream << "#shape_sphere 0  0.33333333333 0 0  1" << endl;
+		stream << "#shape_triangle 0 1 2" << endl;
+	}
+	remove( cacheFileName.c_str() );
+
+	ShapeList::ShapeFactories[ Sphere   ::Directive() ] = new DerivedFactory< Shape , Sphere >();
+	ShapeList::ShapeFactories[ Triangle ::Directive() ] = new DerivedFactory< Shape , Triangle >();
+	ShapeList::ShapeFactories[ ShapeList::Directive() ] = new DerivedFactory< Shape , ShapeList >();
+	GlobalSceneData::LightFactories[ PointLight::Directive() ] = new DerivedFactory< Light , PointLight >();
+	Scene::BaseDir = "";
+	Scene::UseCache = true;
+
+	auto Text = [&]( void )
+	{
+		Scene scene;
+		scene.read( fileName );
+		ostringstream stream;
+		stream << scene;
+		return stream.str();
+	};
+	auto CacheSize = [&]( void )
+	{
+		ifstream stream( cacheFileName , std::ios::binary | std::ios::ate );
+		return stream ? (size_t)stream.tellg() : (size_t)0;
+	};
+	// Overwrites the bytes of the cache at the prescribed offset
+	auto Patch = [&]( size_t offset , const void *data , size_t size )
+	{
+		fstream stream( cacheFileName , std::ios::binary | std::ios::in | std::ios::out );
+		stream.seekp( offset );
+		stream.write( (const char *)data , size );
+	};
+
+	bool success = true;
+	std::string text = Text();
+	size_t cacheSize = CacheSize();
+	if( !cacheSize ){ WARN( "scene cache was not written" ) ; success = false; }
+	if( Text()!=text ){ WARN( "scene read from the cache differs" ) ; success = false; }
+
+	// A cache of a different version should be ignored (and rewritten)
+	uint32_t version = 0;
+	Patch( 8 , &version , sizeof(version) );
+	if( Text()!=text ){ WARN( "scene read past a cache of a different version differs" ) ; success = false; }
+
+	// A cache that fails part-way should be ignored (and rewritten), leaving no trace of what was read before the failure
+	{
+		std::vector< char > data( cacheSize );
+		ifstream( cacheFileName , std::ios::binary ).read( &data[0] , cacheSize );
+		uint64_t size = (uint64_t)( cacheSize - 8 );
+		memcpy( &data[16] , &size , sizeof(size) );
+		ofstream( cacheFileName , std::ios::binary ).write( &data[0] , size );
+	}
+	if( Text()!=text ){ WARN( "scene read past an unreadable cache differs" ) ; success = false; }
+	if( CacheSize()!=cacheSize ){ WARN( "unreadable scene cache was not rewritten" ) ; success = false; }
+
+	Scene::UseCache = false;
+	remove( fileName.c_str() );
+	remove( cacheFileName.c_str() );
+	return success;
+}
+
+/** The vertices parsed in parallel from a run of vertex directives should be identical to those parsed one at a time by stream extraction, whatever the global locale. */
+bool CheckVertexParseEquivalence( void )
+{
+	const int vertexNum = 1000;
+	const char *formats[] = { "%.17g" , "%e" , "%+.3f" , "%.0f." , "%g" };
+	auto Value = [&]( void )
+	{
+		char value[64];
+		double v = ( (double)rand()/RAND_MAX - 0.5 ) * pow( 10. , rand()%9 - 4 );
+		snprintf( value , sizeof(value) , formats[ rand()%5 ] , v );
+		return std::string( value );
+	};
+
+	std::vector< std::string > vertexTexts( vertexNum );
+	// The last coordinate of the normal is fixed, so that no normal vanishes
+	for( int i=0 ; i<vertexNum ; i++ ) for( int j=0 ; j<8 ; j++ ) vertexTexts[i] += ( j==5 ? std::string( "1" ) : Value() ) + ( rand()%4 ? std::string( " " ) : std::string( "\n\t" ) );
+	std::string text;
+	for( int i=0 ; i<vertexNum ; i++ ) text += std::string( "#vertex " ) + vertexTexts[i] + ( i%7 ? std::string( "\n" ) : std::string( " // comment\n" ) );
+	text += "#end\n";
+
+	// Parse under a locale whose decimal separator is a comma, if one is installed
+	const char *commaLocales[] = { "de_DE.UTF-8" , "de_DE" , "fr_FR.UTF-8" , "fr_FR" , "German" , NULL };
+	std::string locale = setlocale( LC_ALL , NULL );
+	for( int i=0 ; commaLocales[i] && !setlocale( LC_ALL , commaLocales[i] ) ; i++ ) ;
+
+	bool success = true;
+	try
+	{
+		LocalSceneData data;
+		istringstream stream( text );
+		stream >> data;
+		if( data.vertices.size()!=vertexNum ){ WARN( "expected " , vertexNum , " vertices: " , data.vertices.size() ) ; success = false; }
+		else for( int i=0 ; i<vertexNum ; i++ )
+		{
+			Vertex vertex;
+			istringstream( vertexTexts[i] ) >> vertex;
+			bool same = true;
+			for( int d=0 ; d<3 ; d++ ) same &= data.vertices[i].position[d]==vertex.position[d] && data.vertices[i].normal[d]==vertex.normal[d];
+			for( int d=0 ; d<2 ; d++ ) same &= data.vertices[i].texCoordinate[d]==vertex.texCoordinate[d];
+			if( !same )
+			{
+				WARN( "vertex parsed differently: " , vertexTexts[i] );
+				success = false;
+				break;
+			}
+		}
+	}
+	catch( const std::exception &e ){ WARN( e.what() ) ; success = false; }
+	setlocale( LC_ALL , locale.c_str() );
+	return success;
+}
+
+struct Check
+{
+	const char *name;
+	bool (*function)( void );
+};
+
+Check checks[] =
+{
+	{ "ray allocations" , CheckRayAllocations } ,
+	{ "checkpoint round-trip" , CheckCheckpointRoundTrip } ,
+	{ "scene cache round-trip" , CheckSceneCacheRoundTrip } ,
+	{ "vertex parse equivalence" , CheckVertexParseEquivalence } ,
+	{ NULL , NULL }
+};
+
+int main( int argc , char *argv[] )
+{
+	int failures = 0;
+	for( int i=0 ; checks[i].name ; i++ )
+	{
+		bool success = false;
+		try{ success = checks[i].function(); }
+		catch( const std::exception &e ){ WARN( e.what() ); }
+		cout << ( success ? "[PASSED] " : "[FAILED] " ) << checks[i].name << endl;
+		if( !success ) failures++;
+	}
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -33,12 +33,14 @@ CmdLineReadable Gray( "gray" );
 CmdLineReadable Blur3X3( "blur3x3" );
 CmdLineReadable Edges3X3( "edges3x3" );
 CmdLineReadable Fun( "fun" );
+CmdLineReadable Tiled( "tiled" );
 
 CmdLineReadable* params[] =
 {
 	&Input , &Output , &Composite , &BeierNeelyMorph , &Crop , &Noisify , &Brighten , &Contrast , &Saturate ,
 	&ScaleNearest , &ScaleBilinear , &ScaleGaussian , &RotateNearest , &RotateBilinear , &RotateGaussian ,
 	&Quantize , &RandomDither , &OrderedDither2X2 , &FloydSteinbergDither , &Gray , &Blur3X3 , &Edges3X3 , &Fun ,
+	&Tiled ,
 	NULL
 };
 
@@ -68,6 +70,7 @@ void ShowUsage( const string &ex )
 	cout << "\t[--" << Edges3X3.name << "]" << endl;
 	cout << "\t[--" << Fun.name << "]" << endl;
 	cout << "\t[--" << Gray.name << "]" << endl;
+	cout << "\t[--" << Tiled.name << "]" << endl;
 }
 
 int main( int argc , char *argv[] )
@@ -75,6 +78,9 @@ int main( int argc , char *argv[] )
 	CmdLineParse( argc-1 , argv+1 , params );
 	if( !Input.set ) { ShowUsage( argv[0] ) ; return EXIT_FAILURE; }
 
+	// Store the images in tiles, so that filters accessing nearby pixels (e.g. rotation and scaling) are more cache-friendly
+	if( Tiled.set ) Image32::DefaultLayout = Image32::TILED;
+
 	// Try to read in the input image
 	Image32 image;
 	image.read( Input.value );
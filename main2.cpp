@@ -34,12 +34,24 @@ CmdLineParameter< int > RecursionLimit( "rLimit" , 5 );
 CmdLineParameter< float > CutOffThreshold( "cutOff" , 0.0001f );
 CmdLineParameter< int > LightSamples( "lSamples" , 100 );
 CmdLineParameter< int > Parallelization( "parallel" , (int)ThreadPool::THREAD_POOL );
+CmdLineParameter< int > TileSize( "tile" , 16 );
+CmdLineParameter< int > PacketSize( "packet" , 1 );
 CmdLineReadable Progress( "progress" );
+CmdLineReadable BoundingVolumeHierarchy( "bvh" );
+CmdLineReadable CompactMeshes( "compact" );
+CmdLineParameter< int > SamplerType( "sampler" , (int)Sampler::SOBOL );
+CmdLineParameter< int > PilotSamples( "pilot" , 4 );
+CmdLineParameter< int > PixelSamples( "aa" , 1 );
+CmdLineParameter< float > PixelSampleThreshold( "aaThreshold" , 0.1f );
+CmdLineParameter< int > ProgressivePasses( "passes" , 1 );
+CmdLineParameter< string > CheckpointFile( "checkpoint" );
+CmdLineParameter< string > PreviewFile( "preview" );
+CmdLineReadable SceneCache( "cache" );
 
 
 CmdLineReadable* params[] =
 {
-	&InputRayFile , &OutputImageFile , &ImageWidth , &ImageHeight , &RecursionLimit , &CutOffThreshold , &LightSamples , &Progress , &Parallelization ,
+	&InputRayFile , &OutputImageFile , &ImageWidth , &ImageHeight , &RecursionLimit , &CutOffThreshold , &LightSamples , &Progress , &Parallelization , &TileSize , &PacketSize , &BoundingVolumeHierarchy , &CompactMeshes , &SamplerType , &PilotSamples , &PixelSamples , &PixelSampleThreshold , &ProgressivePasses , &CheckpointFile , &PreviewFile , &SceneCache ,
 	NULL
 };
 
@@ -55,7 +67,20 @@ void ShowUsage( const string &ex )
 	cout << "\t[--" << LightSamples.name << " <light samples>=" << LightSamples.value << "]" << endl;
 	cout << "\t[--" << Parallelization.name << " <parallelization type>=" << Parallelization.value << "]" << endl;
 	for( unsigned int i=0 ; i<ThreadPool::ParallelNames.size() ; i++ ) cout << "\t\t" << i << "] " << ThreadPool::ParallelNames[i] << std::endl;
+	cout << "\t[--" << TileSize.name << " <tile size>=" << TileSize.value << "]" << endl;
+	cout << "\t[--" << PacketSize.name << " <primary ray packet size (1, 4, 8, or 16)>=" << PacketSize.value << "]" << endl;
 	cout << "\t[--" << Progress.name << "]" << endl;
+	cout << "\t[--" << BoundingVolumeHierarchy.name << "]" << endl;
+	cout << "\t[--" << CompactMeshes.name << "]" << endl;
+	cout << "\t[--" << SamplerType.name << " <sampler type>=" << SamplerType.value << "]" << endl;
+	for( unsigned int i=0 ; i<Sampler::SamplerNames.size() ; i++ ) cout << "\t\t" << i << "] " << Sampler::SamplerNames[i] << std::endl;
+	cout << "\t[--" << PixelSamples.name << " <maximum rays per adaptively supersampled pixel>=" << PixelSamples.value << "]" << endl;
+	cout << "\t[--" << PixelSampleThreshold.name << " <color difference triggering supersampling>=" << PixelSampleThreshold.value << "]" << endl;
+	cout << "\t[--" << ProgressivePasses.name << " <progressive rendering passes>=" << ProgressivePasses.value << "]" << endl;
+	cout << "\t[--" << CheckpointFile.name << " <progressive rendering checkpoint file>]" << endl;
+	cout << "\t[--" << PreviewFile.name << " <progressive rendering preview image file>]" << endl;
+	cout << "\t[--" << PilotSamples.name << " <pilot light samples (0 to disable adaptive sampling)>=" << PilotSamples.value << "]" << endl;
+	cout << "\t[--" << SceneCache.name << "]" << endl;
 }
 
 /** A wrapper class for size_t that prints out comma-separated numbers */
@@ -97,6 +122,18 @@ int main( int argc , char *argv[] )
 	ThreadPool::Init( (ThreadPool::ParallelType)Parallelization.value );
 
 	Scene::BaseDir = GetFileDirectory( InputRayFile.value );
+	ShapeList::UseBVH = BoundingVolumeHierarchy.set;
+	TriangleList::Compact = CompactMeshes.set;
+	Scene::TileSize = (unsigned int)std::max< int >( TileSize.value , 1 );
+	Scene::PacketSize = (unsigned int)std::max< int >( PacketSize.value , 1 );
+	Sampler::Type = (Sampler::SamplerType)SamplerType.value;
+	Sampler::PilotSamples = (unsigned int)std::max< int >( PilotSamples.value , 0 );
+	Scene::PixelSamples = (unsigned int)std::max< int >( PixelSamples.value , 1 );
+	Scene::PixelSampleThreshold = PixelSampleThreshold.value;
+	Scene::ProgressivePasses = (unsigned int)std::max< int >( ProgressivePasses.value , 1 );
+	if( CheckpointFile.set ) Scene::CheckpointFile = CheckpointFile.value;
+	if( PreviewFile.set ) Scene::PreviewFile = PreviewFile.value;
+	Scene::UseCache = SceneCache.set;
 	Scene scene;
 	try
 	{
@@ -119,12 +156,8 @@ int main( int argc , char *argv[] )
 		GlobalSceneData::LightFactories[ SpotLight       ::Directive() ] = new DerivedFactory< Light , SpotLight >();
 		GlobalSceneData::LightFactories[ SphereLight     ::Directive() ] = new DerivedFactory< Light , SphereLight >();
 
-		ifstream istream;
-		istream.open( InputRayFile.value );
-		if( !istream ) THROW( "Failed to open file for reading: " , InputRayFile.value );
-
 		Timer timer;
-		istream >> scene;
+		scene.read( InputRayFile.value );
 		std::cout << "\tRead: " << timer.elapsed() << " seconds" << std::endl;
 
 		timer.reset();
@@ -133,11 +166,15 @@ int main( int argc , char *argv[] )
 		std::cout << "\tRay-traced: " << timer.elapsed() << " seconds" << std::endl;
 		std::cout << "\tPixels: " << Size_t( ImageWidth.value ) << " x " << Size_t( ImageHeight.value ) << std::endl;
 		std::cout << "\tPrimitives: " << Size_t( scene.primitiveNum() ) << std::endl;
-		std::cout << "\tRays: " << Size_t( RayTracingStats::RayNum() ) << " (" << (double)RayTracingStats::RayNum()/(ImageWidth.value*ImageHeight.value) << " rays/pixel)" << std::endl;
-		std::cout << "\tPrimitive intersections: " << Size_t( RayTracingStats::RayPrimitiveIntersectionNum() ) << " (" << (double)RayTracingStats::RayPrimitiveIntersectionNum()/RayTracingStats::RayNum() << " intersections/ray)" << std::endl;
-		std::cout << "\tBounding-box intersections: " << Size_t( RayTracingStats::RayBoundingBoxIntersectionNum() ) << " (" << (double)RayTracingStats::RayBoundingBoxIntersectionNum()/RayTracingStats::RayNum() << " intersections/ray)" << std::endl;
-		if( RayTracingStats::ConeBoundingBoxIntersectionNum() )
-			std::cout << "\tCone-bounding-box intersections: " << Size_t( RayTracingStats::ConeBoundingBoxIntersectionNum() ) << " (" << (double)RayTracingStats::ConeBoundingBoxIntersectionNum()/RayTracingStats::RayNum() << " intersections/ray)" << std::endl;
+		if( !RayTracingStats::Enabled ) std::cout << "\tRay-tracing statistics disabled" << std::endl;
+		else
+		{
+			std::cout << "\tRays: " << Size_t( RayTracingStats::RayNum() ) << " (" << (double)RayTracingStats::RayNum()/(ImageWidth.value*ImageHeight.value) << " rays/pixel)" << std::endl;
+			std::cout << "\tPrimitive intersections: " << Size_t( RayTracingStats::RayPrimitiveIntersectionNum() ) << " (" << (double)RayTracingStats::RayPrimitiveIntersectionNum()/RayTracingStats::RayNum() << " intersections/ray)" << std::endl;
+			std::cout << "\tBounding-box intersections: " << Size_t( RayTracingStats::RayBoundingBoxIntersectionNum() ) << " (" << (double)RayTracingStats::RayBoundingBoxIntersectionNum()/RayTracingStats::RayNum() << " intersections/ray)" << std::endl;
+			if( RayTracingStats::ConeBoundingBoxIntersectionNum() )
+				std::cout << "\tCone-bounding-box intersections: " << Size_t( RayTracingStats::ConeBoundingBoxIntersectionNum() ) << " (" << (double)RayTracingStats::ConeBoundingBoxIntersectionNum()/RayTracingStats::RayNum() << " intersections/ray)" << std::endl;
+		}
 		if( OutputImageFile.set ) img.write( OutputImageFile.value );
 	}
 	catch( const exception &e )
@@ -24,10 +24,11 @@ CmdLineParameter< string > InputRayFile( "in" );
 CmdLineParameter< int > WindowWidth( "width" , 640 );
 CmdLineParameter< int > WindowHeight( "height" , 480 );
 CmdLineParameter< int > Complexity( "cplx" , 10 );
+CmdLineReadable SceneCache( "cache" );
 
 CmdLineReadable* params[] =
 {
-	&InputRayFile , &WindowWidth , &WindowHeight , &Complexity ,
+	&InputRayFile , &WindowWidth , &WindowHeight , &Complexity , &SceneCache ,
 	NULL
 };
 
@@ -38,6 +39,7 @@ void ShowUsage( const string &ex )
 	cout << "\t[--" << WindowWidth.name << " <window width>=" << WindowWidth.value << "]" << endl;
 	cout << "\t[--" << WindowHeight.name << " <window height>=" << WindowHeight.value << "]" << endl;
 	cout << "\t[--" << Complexity.name << " <tessellation complexity>=" << Complexity.value << "]" << endl;
+	cout << "\t[--" << SceneCache.name << "]" << endl;
 }
 
 int main( int argc , char *argv[] )
@@ -64,11 +66,9 @@ int main( int argc , char *argv[] )
 		GlobalSceneData::LightFactories[ SphereLight     ::Directive() ] = new DerivedFactory< Light , SphereLight >();
 
 		Scene::BaseDir = GetFileDirectory( InputRayFile.value );
+		Scene::UseCache = SceneCache.set;
 		Scene scene;
-		ifstream istream;
-		istream.open( InputRayFile.value );
-		if( !istream ) THROW( "Failed to open file for reading: " , InputRayFile.value );
-		istream >> scene;
+		scene.read( InputRayFile.value );
 		Shape::OpenGLTessellationComplexity = Complexity.value;
 		Window::View( scene , WindowWidth.value , WindowHeight.value );
 	}
@@ -27,10 +27,11 @@ CmdLineParameter< int > InterpolantType( "interpolant" , Interpolation::NEAREST+
 CmdLineParameter< int > WindowWidth( "width" , 640 );
 CmdLineParameter< int > WindowHeight( "height" , 480 );
 CmdLineParameter< int > Complexity( "cplx" , 10 );
+CmdLineReadable SceneCache( "cache" );
 
 CmdLineReadable* params[] =
 {
-	&InputRayFile , &WindowWidth , &WindowHeight , &Complexity , &ParameterType , &InterpolantType ,
+	&InputRayFile , &WindowWidth , &WindowHeight , &Complexity , &ParameterType , &InterpolantType , &SceneCache ,
 	NULL
 };
 
@@ -45,6 +46,7 @@ void ShowUsage( const string &ex )
 	cout << "\t[--" << WindowWidth.name << " <window width>=" << WindowWidth.value << "]" << endl;
 	cout << "\t[--" << WindowHeight.name << " <window height>=" << WindowHeight.value << "]" << endl;
 	cout << "\t[--" << Complexity.name << " <tessellation complexity>=" << Complexity.value << "]" << endl;
+	cout << "\t[--" << SceneCache.name << "]" << endl;
 }
 
 int main( int argc , char *argv[] )
@@ -53,6 +55,7 @@ int main( int argc , char *argv[] )
 	if( !InputRayFile.set ){ ShowUsage( argv[0] ) ; return EXIT_FAILURE; }
 
 	Scene::BaseDir = GetFileDirectory( InputRayFile.value );
+	Scene::UseCache = SceneCache.set;
 	Scene scene;
 	try
 	{
@@ -77,10 +80,7 @@ int main( int argc , char *argv[] )
 		Window::interpolationType = InterpolantType.value-1;
 		Window::parametrizationType = ParameterType.value-1;
 
-		ifstream istream;
-		istream.open( InputRayFile.value );
-		if( !istream ) THROW( "Failed to open file for reading: " , InputRayFile.value );
-		istream >> scene;
+		scene.read( InputRayFile.value );
 		Window::View( scene , WindowWidth.value , WindowHeight.value );
 	}
 	catch( const exception& e )